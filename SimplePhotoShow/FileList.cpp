@@ -0,0 +1,25 @@
+#include "FileList.h"
+
+void FileList::AddFolder(const std::wstring &folderPath)
+{
+	m_folders.push_back(folderPath);
+}
+
+void FileList::AddFile(const std::wstring &fileName)
+{
+	Entry entry;
+	entry.folder = static_cast<uint32_t>(m_folders.size() - 1);
+	entry.nameOffset = static_cast<uint32_t>(m_names.size());
+	entry.nameLength = static_cast<uint32_t>(fileName.size());
+	m_names.append(fileName);
+	m_files.push_back(entry);
+}
+
+std::wstring FileList::GetPath(uint32_t index) const
+{
+	const Entry &entry = m_files[index];
+	std::wstring path = m_folders[entry.folder];
+	path.append(L"\\");
+	path.append(m_names, entry.nameOffset, entry.nameLength);
+	return path;
+}
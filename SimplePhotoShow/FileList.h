@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Immutable list of image paths shared by all displays. Each folder path is stored
+// once and file names are packed in a single buffer; files are referred to by a
+// 32-bit index, displays only keep their own order of indices.
+class FileList
+{
+public:
+	void AddFolder(const std::wstring &folderPath);
+	// adds a file to the last added folder
+	void AddFile(const std::wstring &fileName);
+
+	uint32_t Size() const { return static_cast<uint32_t>(m_files.size()); }
+	std::wstring GetPath(uint32_t index) const;
+
+private:
+	struct Entry
+	{
+		uint32_t folder;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+	};
+
+	std::vector<std::wstring> m_folders;
+	std::vector<Entry> m_files;
+	std::wstring m_names;
+};
@@ -30,3 +30,40 @@ bool ListFilesInDirectory(const std::wstring &dirPath, std::vector<std::wstring>
 
 	return true;
 }
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+}
+
+bool MappedFile::Open(const std::wstring &path)
+{
+	m_file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// WIC memory streams are limited to 32-bit sizes
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0 || size.QuadPart > MAXDWORD)
+		return false;
+
+	m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr)
+		return false;
+	m_data = static_cast<const BYTE *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+		return false;
+	m_size = static_cast<DWORD>(size.QuadPart);
+
+#if _WIN32_WINNT >= _WIN32_WINNT_WIN8
+	// pages come in with large reads in the background instead of one fault at a time
+	WIN32_MEMORY_RANGE_ENTRY range = { const_cast<BYTE *>(m_data), m_size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+	return true;
+}
@@ -1,7 +1,29 @@
 #pragma once
+#include <windows.h>
 #include <vector>
 #include <string>
 #include <functional>
 
 // return true if directory exists
 bool ListFilesInDirectory(const std::wstring &dirPath, std::vector<std::wstring> &outNameList, std::function<bool(const std::wstring &)> filter);
+
+// A whole file mapped read-only, so that decoders read the file cache in place instead of
+// copying it through ReadFile; the file is read ahead sequentially as soon as it is open.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool Open(const std::wstring &path);
+	const BYTE *Data() const { return m_data; }
+	DWORD Size() const { return m_size; }
+
+private:
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+	const BYTE *m_data = nullptr;
+	DWORD m_size = 0;
+};
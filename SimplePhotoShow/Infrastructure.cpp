@@ -44,7 +44,7 @@ namespace
 		return text;
 	}
 
-	std::vector<std::wstring> buildFileList(const std::wstring &foldersStr, bool shuffle)
+	std::shared_ptr<const FileList> buildFileList(const std::wstring &foldersStr)
 	{
 		std::vector<std::wstring> folders;
 		if (!foldersStr.empty()) {
@@ -54,7 +54,7 @@ namespace
 				std::back_inserter(folders));
 		}
 
-		std::vector<std::wstring> result;
+		auto result = std::make_shared<FileList>();
 		for (const std::wstring &dirPath : folders) {
 			std::vector<std::wstring> fileNameList;
 			ListFilesInDirectory(dirPath, fileNameList, [](const std::wstring &name) {
@@ -62,18 +62,16 @@ namespace
 					EndsWith(name, std::wstring(L".jpeg")) ||
 					EndsWith(name, std::wstring(L".png"));
 			});
+			result->AddFolder(dirPath);
 			for (const std::wstring &fileName : fileNameList) {
-				result.push_back(dirPath + L"\\" + fileName);
+				result->AddFile(fileName);
 			}
 		}
-		if (shuffle) {
-			std::shuffle(result.begin(), result.end(), std::random_device());
-		}
 		return result;
 	}
 
 	bool s_shuffleImages = true;
-	std::vector<std::wstring> s_imageFileList;
+	std::shared_ptr<const FileList> s_imageFileList;
 	std::map<LPVOID, std::shared_ptr<PhotoShow>> s_photoShows;
 	LONG s_offsetLeft = 0;
 	LONG s_offsetTop = 0;
@@ -101,11 +99,8 @@ namespace
 				RECT rect;
 				GetClientRect(hWnd, &rect);
 				DEBUG_LOG("GetClientRect: " << rect.left << ' ' << rect.top << ' ' << rect.right << ' ' << rect.bottom);
-				// shuffle again to avoid same image sequence on different monitors
-				if (s_shuffleImages) {
-					std::shuffle(s_imageFileList.begin(), s_imageFileList.end(), std::random_device());
-				}
-				photoShow.reset(new PhotoShow(rect.right, rect.bottom, D2D1::RectF((FLOAT)lpRect->left, (FLOAT)lpRect->top, (FLOAT)lpRect->right, (FLOAT)lpRect->bottom), s_imageFileList), RefCntDeleter());
+				// each display shuffles its own order to avoid same image sequence on different monitors
+				photoShow.reset(new PhotoShow(rect.right, rect.bottom, D2D1::RectF((FLOAT)lpRect->left, (FLOAT)lpRect->top, (FLOAT)lpRect->right, (FLOAT)lpRect->bottom), s_imageFileList, s_shuffleImages), RefCntDeleter());
 			}
 			photoShow->LoadNextImage(hWnd);
 			return lpParam->waitIndex < 0 ? TRUE : FALSE;
@@ -142,6 +137,15 @@ namespace
 		return DoCallOnPaint((LPVOID)hMonitor, lprcMonitor, (HWND)dwData);
 	}
 
+	// A fade still running asked for its next frame while painting: wait for the compositor
+	// to present this one, so frames follow the display refresh whatever the number of displays.
+	void WaitForNextFrame(HWND hWnd)
+	{
+		if (GetUpdateRect(hWnd, nullptr, FALSE)) {
+			DwmFlush();
+		}
+	}
+
 	static int currentIndex = 0;
 
 	void StartSlideShow(HWND hWnd, bool isScreenSaver, const Configuration &config)
@@ -155,7 +159,7 @@ namespace
 			SetLayeredWindowAttributes(hWnd, 0, 255 - config.transparency, LWA_ALPHA);
 		}
 
-		s_imageFileList = buildFileList(config.folders, config.shuffle);
+		s_imageFileList = buildFileList(config.folders);
 
 		if (isScreenSaver) {
 			EnumDisplayMonitors(nullptr, nullptr, &GetOffsets, 0);
@@ -250,6 +254,7 @@ ScreenSaverProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 				DEBUG_LOG("Dirty Rect: " << ps.rcPaint.left << ' ' << ps.rcPaint.top << ' ' << ps.rcPaint.right << ' ' << ps.rcPaint.bottom);
 				EnumDisplayMonitors(ps.hdc, &ps.rcPaint, &CallOnPaint, (LPARAM)hWnd);
 				EndPaint(hWnd, &ps);
+				WaitForNextFrame(hWnd);
 			}
 			return S_OK;
 		}
@@ -469,6 +474,7 @@ WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					FillRect(ps.hdc, &ps.rcPaint, (HBRUSH)GetStockObject(BLACK_BRUSH));
 				}
 				EndPaint(hWnd, &ps);
+				WaitForNextFrame(hWnd);
 			}
 			return S_OK;
 		}
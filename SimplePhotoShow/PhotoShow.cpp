@@ -20,7 +20,6 @@ const float DEFAULT_DPI = 96.f;   // Default DPI that maps image resolution dire
 const float BACKGROUND_DARKEN = 0.6f;
 
 #define ANIMATION_LENGTH 1000
-#define ANIMATION_PRECISION 33	// frame per second
 
 template <typename T>
 inline void SafeRelease(T *&p)
@@ -31,66 +30,6 @@ inline void SafeRelease(T *&p)
 	}
 }
 
-namespace {
-	FLOAT peekaboo(std::random_device &randomizer, const std::vector<FLOAT> &pos, std::vector<FLOAT> &weight, FLOAT currentLength)
-	{
-		FLOAT window = pos.back();
-
-		if (currentLength >= window) {
-			return 0.f;
-		}
-
-		FLOAT halfSize = currentLength / 2;
-
-		int startIndex = 0;
-		for (; startIndex < int(pos.size()); ++startIndex) {
-			if (pos[startIndex] >= halfSize) {
-				--startIndex;
-				break;
-			}
-		}
-
-		int endIndex = pos.size() - 1;
-		for (; endIndex >= 0; --endIndex) {
-			if (window - pos[endIndex] >= halfSize) {
-				endIndex += 2;
-				break;
-			}
-		}
-
-		if (endIndex >= 0 && startIndex < endIndex) {
-			FLOAT center = static_cast<FLOAT>(std::piecewise_linear_distribution<>(pos.begin() + startIndex, pos.begin() + endIndex, weight.begin() + startIndex)(randomizer));
-			FLOAT left = std::max(0.0f, std::min(center - halfSize, window - currentLength));
-			FLOAT right = left + currentLength;
-			for (size_t i = 0; i < pos.size(); ++i) {
-				if (pos[i] >= left && pos[i] <= right) {
-					weight[i] = 1.f;
-				}
-				else {
-					weight[i] += 2.f;
-				}
-			}
-			return left;
-		}
-		return std::uniform_real_distribution<FLOAT>(0, window - currentLength)(randomizer);
-	}
-
-	void initWeightRange(std::vector<FLOAT> &weightPos, std::vector<FLOAT> &weightValue, unsigned rangeCount, FLOAT length)
-	{
-		weightPos.reserve(rangeCount+1);
-		FLOAT rangeWidth = length / rangeCount;
-		FLOAT pos = 0;
-		while (weightPos.size() < rangeCount) {
-			weightPos.push_back(pos);
-			pos = pos + rangeWidth;
-		}
-		weightPos.push_back(length);
-		weightValue.resize(weightPos.size());
-		std::fill(weightValue.begin(), weightValue.end(), 1.0f);
-	}
-
-}
-
 int PhotoShow::s_instanceCount = 0;
 int PhotoShow::s_virtualWidth = 0;
 int PhotoShow::s_virtualHeight = 0;
@@ -98,15 +37,17 @@ IWICImagingFactory* PhotoShow::s_wicFactory = nullptr;
 ID2D1Factory* PhotoShow::s_d2dFactory = nullptr;
 ID2D1HwndRenderTarget* PhotoShow::s_renderTarget = nullptr;
 
-PhotoShow::PhotoShow(int virtualScreenWidth, int virtualScreenHeight, const D2D1_RECT_F &screenRect, const std::vector<std::wstring> &imageList)
+PhotoShow::PhotoShow(int virtualScreenWidth, int virtualScreenHeight, const D2D1_RECT_F &screenRect, const std::shared_ptr<const FileList> &imageList, bool shuffle)
 	: m_screenRect(screenRect),
 	m_animProgress(0),
 	m_backgroundTarget(nullptr),
 	m_d2dBitmap(nullptr),
 	m_bitmapConverter(nullptr),
 	m_bitmapRect(),
+	m_animating(false),
 	m_fileList(imageList),
-	m_currentFileIndex(0),
+	m_shuffle(shuffle),
+	m_currentFileIndex(imageList->Size()),	// the first image starts a pass
 	m_renderTarget(nullptr)
 {
 	HRESULT hr = S_OK;
@@ -135,15 +76,19 @@ PhotoShow::PhotoShow(int virtualScreenWidth, int virtualScreenHeight, const D2D1
 
 	}
 
-	int numberOfRange = 20;
-	initWeightRange(m_weightPosX, m_weightValueX, numberOfRange, screenRect.right - screenRect.left);
-	initWeightRange(m_weightPosY, m_weightValueY, numberOfRange, screenRect.bottom - screenRect.top);
+
+	// about 240 cells across the longer side whatever the screen
+	int screenWidth = int(screenRect.right - screenRect.left);
+	int screenHeight = int(screenRect.bottom - screenRect.top);
+	uint64_t seed = (uint64_t(m_randomizer()) << 32) | m_randomizer();
+	m_placement.reset(new PlacementGrid(screenWidth, screenHeight, std::max(4, std::max(screenWidth, screenHeight) / 240), seed));
 }
 
 PhotoShow::~PhotoShow()
 {
 	SafeRelease(m_d2dBitmap);
 	SafeRelease(m_bitmapConverter);
+	m_bitmapFile.reset();
 	SafeRelease(m_backgroundTarget);
 
 	if (--s_instanceCount == 0) {
@@ -155,11 +100,16 @@ PhotoShow::~PhotoShow()
 HRESULT
 PhotoShow::LocateNextImage(LPWSTR pszFileName)
 {
-	if (m_currentFileIndex >= m_fileList.size()) {
+	if (m_currentFileIndex >= m_fileList->Size()) {
 		m_currentFileIndex = 0;
+		if (m_shuffle) {
+			uint64_t seed = (uint64_t(m_randomizer()) << 32) | m_randomizer();
+			m_fileOrder = RandomPermutation(m_fileList->Size(), seed);
+		}
 	}
-	if (m_currentFileIndex < m_fileList.size()) {
-		StringCchCopy(pszFileName, MAX_PATH, m_fileList[m_currentFileIndex].c_str());
+	if (m_currentFileIndex < m_fileList->Size()) {
+		uint32_t index = m_shuffle ? static_cast<uint32_t>(m_fileOrder(m_currentFileIndex)) : m_currentFileIndex;
+		StringCchCopy(pszFileName, MAX_PATH, m_fileList->GetPath(index).c_str());
 		++m_currentFileIndex;
 		return S_OK;
 	}
@@ -174,13 +124,33 @@ PhotoShow::LoadNextImage(HWND hWnd)
 
 	if (SUCCEEDED(hr)) {
 		IWICBitmapDecoder *pDecoder = nullptr;
-		hr = s_wicFactory->CreateDecoderFromFilename(
-			szFileName,                      // Image to be decoded
-			nullptr,                         // Do not prefer a particular vendor
-			GENERIC_READ,                    // Desired read access to the file
-			WICDecodeMetadataCacheOnDemand,  // Cache metadata when needed
-			&pDecoder                        // Pointer to the decoder
-			);
+		IWICStream *pStream = nullptr;
+		// the decoder reads the mapped file in place rather than through its own buffered reads
+		auto file = std::make_unique<MappedFile>();
+		if (file->Open(szFileName)) {
+			hr = s_wicFactory->CreateStream(&pStream);
+			if (SUCCEEDED(hr)) {
+				hr = pStream->InitializeFromMemory(const_cast<BYTE *>(file->Data()), file->Size());
+			}
+			if (SUCCEEDED(hr)) {
+				hr = s_wicFactory->CreateDecoderFromStream(
+					pStream,                         // Mapped image to be decoded
+					nullptr,                         // Do not prefer a particular vendor
+					WICDecodeMetadataCacheOnDemand,  // Cache metadata when needed
+					&pDecoder                        // Pointer to the decoder
+					);
+			}
+		}
+		else {
+			file.reset();
+			hr = s_wicFactory->CreateDecoderFromFilename(
+				szFileName,                      // Image to be decoded
+				nullptr,                         // Do not prefer a particular vendor
+				GENERIC_READ,                    // Desired read access to the file
+				WICDecodeMetadataCacheOnDemand,  // Cache metadata when needed
+				&pDecoder                        // Pointer to the decoder
+				);
+		}
 
 		IWICBitmapFrameDecode *pFrame = nullptr;
 		if (SUCCEEDED(hr)) {
@@ -188,6 +158,7 @@ PhotoShow::LoadNextImage(HWND hWnd)
 		}
 		if (SUCCEEDED(hr)) {
 			SafeRelease(m_bitmapConverter);
+			m_bitmapFile = std::move(file);
 			hr = s_wicFactory->CreateFormatConverter(&m_bitmapConverter);
 			if (SUCCEEDED(hr)) {
 				hr = m_bitmapConverter->Initialize(
@@ -242,40 +213,42 @@ PhotoShow::LoadNextImage(HWND hWnd)
 				std::tie(imgWidth, imgHeight) = ScaleToFit(imgWidth, imgHeight, screenWidth, screenHeight); // m_renderTarget->GetSize();
 			}
 
-			auto newX = peekaboo(m_randomizer, m_weightPosX, m_weightValueX, imgWidth);
-			auto newY = peekaboo(m_randomizer, m_weightPosY, m_weightValueY, imgHeight);
+			int newX, newY;
+			std::tie(newX, newY) = m_placement->Place(RoundToNearest(imgWidth), RoundToNearest(imgHeight));
 			m_bitmapRect = D2D1::RectF(float(newX), float(newY), float(newX + imgWidth), float(newY + imgHeight));
 
+			// frames are requested by OnPaint until the fade ends
 			m_animProgress = 0.0f;
-			Invalidate(hWnd);
-			ref();
+			m_animating = true;
 			m_animStart = std::chrono::steady_clock::now();
-			SetTimer(hWnd, UINT_PTR(this), 1000 / ANIMATION_PRECISION, &NextAnimationFrame);
+			m_frameCount = 0;
+			m_frameIntervalMax = 0.f;
+			Invalidate(hWnd);
 		}
 
 		SafeRelease(pDecoder);
+		SafeRelease(pStream);
 		SafeRelease(pFrame);
 	}
 	return SUCCEEDED(hr);
 }
 
 void
-PhotoShow::NextAnimationFrame(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+PhotoShow::AdvanceAnimation()
 {
-	PhotoShow* thiz = (PhotoShow*) idEvent;
-	
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - thiz->m_animStart).count();
-	if (duration >= ANIMATION_LENGTH)
-	{
-		KillTimer(hWnd, idEvent);
-		thiz->m_animProgress = 1.f;
-		thiz->Invalidate(hWnd);
-		thiz->unref();
+	auto now = std::chrono::steady_clock::now();
+	if (m_frameCount > 0) {
+		FLOAT interval = std::chrono::duration<FLOAT, std::milli>(now - m_lastFrame).count();
+		m_frameIntervalMax = std::max(m_frameIntervalMax, interval);
 	}
-	else
-	{
-		thiz->m_animProgress = duration / FLOAT(ANIMATION_LENGTH);
-		thiz->Invalidate(hWnd);
+	m_lastFrame = now;
+	++m_frameCount;
+
+	auto duration = std::chrono::duration<FLOAT, std::milli>(now - m_animStart).count();
+	m_animProgress = std::min(1.f, duration / ANIMATION_LENGTH);
+	if (m_animProgress >= 1.f) {
+		m_animating = false;
+		DEBUG_LOG("Fade: " << m_frameCount << " frames, max interval " << m_frameIntervalMax << " ms");
 	}
 }
 
@@ -303,6 +276,10 @@ PhotoShow::OnPaint(HWND hWnd)
 	// Create render target if not yet created
 	HRESULT hr = CreateDeviceResources(hWnd);
 
+	if (m_animating) {
+		AdvanceAnimation();
+	}
+
 	if (SUCCEEDED(hr) && m_renderTarget != nullptr && m_backgroundTarget != nullptr && !(m_renderTarget->CheckWindowState() & D2D1_WINDOW_STATE_OCCLUDED))
 	{
 		m_renderTarget->BeginDraw();
@@ -352,6 +329,11 @@ PhotoShow::OnPaint(HWND hWnd)
 			hr = S_OK;
 		}
 	}
+
+	if (m_animating) {
+		// next frame, the window procedure waits for this one to be composed first
+		Invalidate(hWnd);
+	}
 }
 
 void
@@ -385,7 +367,8 @@ PhotoShow::CreateDeviceResources(HWND hWnd)
 
 		hr = s_d2dFactory->CreateHwndRenderTarget(
 			renderTargetProperties,
-			D2D1::HwndRenderTargetProperties(hWnd, size),
+			// paced by the window procedure, so that several displays don't each wait for vsync
+			D2D1::HwndRenderTargetProperties(hWnd, size, D2D1_PRESENT_OPTIONS_IMMEDIATELY),
 			&s_renderTarget
 			);
 	}
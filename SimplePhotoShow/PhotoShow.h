@@ -6,13 +6,18 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <memory>
 
 #include "RefCnt.h"
+#include "FileList.h"
+#include "FileUtil.h"
+#include "Permutation.h"
+#include "PlacementGrid.h"
 
 class PhotoShow : public RefCnt<PhotoShow>
 {
 public:
-	PhotoShow(int virtualScreenWidth, int virtualScreenHeight, const D2D1_RECT_F &screenRect, const std::vector<std::wstring> &imageList);
+	PhotoShow(int virtualScreenWidth, int virtualScreenHeight, const D2D1_RECT_F &screenRect, const std::shared_ptr<const FileList> &imageList, bool shuffle);
 	~PhotoShow();
 
 	void OnPaint(HWND hWnd);
@@ -23,22 +28,27 @@ private:
 	D2D1_RECT_F m_screenRect;
 
 	FLOAT m_animProgress;
-	std::vector<FLOAT> m_weightPosX;
-	std::vector<FLOAT> m_weightValueX;
-	std::vector<FLOAT> m_weightPosY;
-	std::vector<FLOAT> m_weightValueY;
+	bool m_animating;
+	std::unique_ptr<PlacementGrid> m_placement;
 
 	ID2D1BitmapRenderTarget *m_backgroundTarget;
 	ID2D1Bitmap				*m_d2dBitmap;
 	IWICFormatConverter		*m_bitmapConverter;
+	std::unique_ptr<MappedFile> m_bitmapFile;	// read by m_bitmapConverter as long as it lives
 
 	D2D1_RECT_F             m_bitmapRect;	// relative to m_screenRect
 
-	std::vector<std::wstring> m_fileList;
-	size_t m_currentFileIndex;
+	std::shared_ptr<const FileList> m_fileList;
+	// own order of each display, a new permutation of m_fileList for each pass when shuffling
+	RandomPermutation m_fileOrder;
+	bool m_shuffle;
+	uint32_t m_currentFileIndex;
 	std::random_device m_randomizer;
 
 	std::chrono::steady_clock::time_point m_animStart;
+	std::chrono::steady_clock::time_point m_lastFrame;
+	unsigned m_frameCount;
+	FLOAT m_frameIntervalMax;
 
 	static int                   s_instanceCount;
 	static int                   s_virtualWidth;
@@ -53,6 +63,5 @@ private:
 	HRESULT CreateDeviceResources(HWND hWnd);
 	void Invalidate(HWND hWnd);
 	void OnRenderTargetReset();
-
-	static void CALLBACK NextAnimationFrame(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+	void AdvanceAnimation();
 };
\ No newline at end of file
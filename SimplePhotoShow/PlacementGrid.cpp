@@ -0,0 +1,99 @@
+#include "PlacementGrid.h"
+#include <algorithm>
+#include <cmath>
+
+PlacementGrid::PlacementGrid(int width, int height, int cellSize, uint64_t seed)
+	: m_cellSize(std::max(1, cellSize)),
+	m_random(seed)
+{
+	Resize(width, height);
+}
+
+void PlacementGrid::Resize(int width, int height)
+{
+	m_width = std::max(1, width);
+	m_height = std::max(1, height);
+	m_columns = (m_width + m_cellSize - 1) / m_cellSize;
+	m_rows = (m_height + m_cellSize - 1) / m_cellSize;
+	m_slide = 0;
+	m_covered.assign(size_t(m_columns) * m_rows, 0);
+	BuildSums();
+}
+
+std::pair<int, int> PlacementGrid::Place(int w, int h)
+{
+	w = std::min(std::max(w, 1), m_width);
+	h = std::min(std::max(h, 1), m_height);
+	int cellsX = (w + m_cellSize - 1) / m_cellSize;
+	int cellsY = (h + m_cellSize - 1) / m_cellSize;
+	int positionsX = m_columns - cellsX + 1;
+	int positionsY = m_rows - cellsY + 1;
+
+	// all candidates have the same area, the least covered sum is the stalest
+	uint64_t area = uint64_t(cellsX) * cellsY;
+	uint64_t least = UINT64_MAX;
+	for (int y = 0; y < positionsY; ++y) {
+		for (int x = 0; x < positionsX; ++x) {
+			least = std::min(least, CoveredSum(x, y, x + cellsX, y + cellsY));
+		}
+	}
+	// staleness counted in slides since each cell was covered
+	uint64_t stalest = area * m_slide - least;
+	uint64_t threshold = stalest - uint64_t(stalest * kTolerance);
+	uint64_t highestSum = area * m_slide - threshold;
+
+	// uniform among the ones close enough, in one pass
+	int pickX = 0;
+	int pickY = 0;
+	uint64_t seen = 0;
+	for (int y = 0; y < positionsY; ++y) {
+		for (int x = 0; x < positionsX; ++x) {
+			if (CoveredSum(x, y, x + cellsX, y + cellsY) <= highestSum && m_random() % ++seen == 0) {
+				pickX = x;
+				pickY = y;
+			}
+		}
+	}
+
+	// anywhere within the cell, images don't line up on the grid
+	std::uniform_int_distribution<int> offset(0, m_cellSize - 1);
+	int left = std::min(pickX * m_cellSize + offset(m_random), m_width - w);
+	int top = std::min(pickY * m_cellSize + offset(m_random), m_height - h);
+	Cover(left, top, w, h);
+	return std::make_pair(left, top);
+}
+
+// the cells whose center the image covers
+void PlacementGrid::Cover(int x, int y, int w, int h)
+{
+	auto cellRange = [this](int begin, int length, int count) {
+		double half = m_cellSize * 0.5;
+		int first = std::min(std::max(int(std::ceil((begin - half) / m_cellSize)), 0), count - 1);
+		int last = std::min(std::max(int(std::ceil((begin + length - half) / m_cellSize)), first + 1), count);
+		return std::make_pair(first, last);
+	};
+	std::pair<int, int> columns = cellRange(x, w, m_columns);
+	std::pair<int, int> rows = cellRange(y, h, m_rows);
+
+	++m_slide;
+	for (int row = rows.first; row < rows.second; ++row) {
+		std::fill_n(m_covered.begin() + size_t(row) * m_columns + columns.first, columns.second - columns.first, m_slide);
+	}
+	BuildSums();
+}
+
+void PlacementGrid::BuildSums()
+{
+	size_t stride = size_t(m_columns) + 1;
+	m_sums.assign(stride * (m_rows + 1), 0);
+	for (int y = 0; y < m_rows; ++y) {
+		uint64_t rowSum = 0;
+		const uint32_t *covered = &m_covered[size_t(y) * m_columns];
+		const uint64_t *above = &m_sums[y * stride];
+		uint64_t *sums = &m_sums[(y + 1) * stride];
+		for (int x = 0; x < m_columns; ++x) {
+			rowSum += covered[x];
+			sums[x + 1] = above[x + 1] + rowSum;
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+
+// A decoded image: its pixels, or for a JPEG decoded without converting its colors, its
+// Y, Cb and Cr planes (full range BT.601, as JFIF has them) in Grayscale8 images. The
+// chroma planes may be subsampled and the luma one padded to a whole chroma pixel; the
+// GPU converts them to RGB when drawing.
+struct DecodedImage
+{
+    DecodedImage() = default;
+    DecodedImage(const QImage &image)
+    : pixels(image),
+      size(image.size())
+    {
+    }
+
+    bool isNull() const { return size.isEmpty(); }
+    bool isPlanar() const { return !planes[0].isNull(); }
+    int width() const { return size.width(); }
+    int height() const { return size.height(); }
+    // luma pixels per chroma pixel, across and down
+    QSize chromaSubsampling() const
+    {
+        return QSize(planes[0].width() / planes[1].width(), planes[0].height() / planes[1].height());
+    }
+
+    QImage pixels;
+    QImage planes[3];
+    QSize size;
+};
@@ -0,0 +1,155 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include "imagedecoder.h"
+#include "imageutil.h"
+#include "latencystats.h"
+#include <iostream>
+#include <iomanip>
+
+// Decode throughput of every decoder backend built in. Each native backend is measured on
+// the files it claims by their magic bytes, then Qt's plugins on the same files, so that
+// both lines of a pair compare the same work.
+
+struct BenchFile {
+    QString path;
+    QByteArray magic;
+    qint64 bytes;
+};
+
+struct BenchResult {
+    LatencyStats decodeMs;
+    qint64 failed = 0;
+    double sourceMegapixels = 0.0;
+    double megabytes = 0.0;
+    double totalMs = 0.0;
+};
+
+static QList<BenchFile> collectFiles(const QStringList &paths)
+{
+    QList<BenchFile> files;
+    auto add = [&files](const QString &filePath) {
+        QByteArray magic = ImageDecoder::readMagic(filePath);
+        if (!magic.isEmpty()) {
+            files.append({ filePath, magic, QFileInfo(filePath).size() });
+        }
+    };
+    for (const auto &path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                add(it.next());
+            }
+        } else {
+            add(path);
+        }
+    }
+    return files;
+}
+
+static BenchResult run(const ImageDecoder *decoder, const QList<BenchFile> &files, const QSize &targetSize, int repeat)
+{
+    BenchResult result;
+    for (int pass = 0; pass < repeat; ++pass) {
+        for (const auto &file : files) {
+            QElapsedTimer timer;
+            timer.start();
+            // sized the way the loader does it, mapping and the size query are part of the work
+            FileData data(file.path);
+            QSize size = decoder->imageSize(data);
+            QSize scaledSize;
+            if (size.isValid() && targetSize.isValid() && (size.width() > targetSize.width() || size.height() > targetSize.height())) {
+                int w, h;
+                std::tie(w, h) = scaleToFit(size.width(), size.height(), targetSize.width(), targetSize.height());
+                scaledSize = QSize(std::max(1, w), std::max(1, h));
+            }
+            data.prefetch();
+            DecodedImage image = decoder->decode(data, scaledSize);
+            double ms = timer.nsecsElapsed() / 1e6;
+            if (image.isNull()) {
+                ++result.failed;
+                continue;
+            }
+            result.decodeMs.add(ms);
+            result.totalMs += ms;
+            result.sourceMegapixels += size.isValid() ? qint64(size.width()) * size.height() / 1e6 : image.width() * double(image.height()) / 1e6;
+            result.megabytes += file.bytes / 1e6;
+        }
+    }
+    return result;
+}
+
+static void print(const char *name, const BenchResult &result)
+{
+    double seconds = result.totalMs / 1000.0;
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << result.decodeMs.count() << " decoded"
+              << std::setw(6) << result.failed << " failed"
+              << std::setw(10) << (seconds > 0 ? result.sourceMegapixels / seconds : 0.0) << " MP/s"
+              << std::setw(10) << (seconds > 0 ? result.megabytes / seconds : 0.0) << " MB/s"
+              << std::setw(9) << result.decodeMs.percentile(0.5) << " ms p50"
+              << std::setw(9) << result.decodeMs.percentile(0.99) << " ms p99" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // Qt's image plugins need an application instance to be found
+    QGuiApplication app(argc, argv);
+
+    QCommandLineOption size(QStringList() << "size", "Decode scaled down to fit this size, as the show would (default: full size).", "WxH", "");
+    QCommandLineOption repeat(QStringList() << "repeat", "Number of passes over the files, the first one also warms the page cache (default: 3).", "count", "3");
+    QCommandLineOption only(QStringList() << "decoder", "Only measure this backend and Qt on its files.", "name", "");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Decoder backend throughput");
+    parser.addHelpOption();
+    parser.addOption(size);
+    parser.addOption(repeat);
+    parser.addOption(only);
+    parser.addPositionalArgument("paths", "Image files or directories, scanned recursively.");
+    parser.process(app);
+
+    QSize targetSize;
+    QStringList sizeParts = parser.value(size).split(QRegularExpression("[xX]"));
+    if (sizeParts.size() == 2) {
+        targetSize = QSize(sizeParts[0].toInt(), sizeParts[1].toInt());
+    }
+    int repeatCount = std::max(1, parser.value(repeat).toInt());
+
+    QList<BenchFile> files = collectFiles(parser.positionalArguments());
+    if (files.isEmpty()) {
+        std::cerr << "No files to decode" << std::endl;
+        return 1;
+    }
+
+    const ImageDecoder *qt = ImageDecoder::find("qt");
+    QList<BenchFile> unclaimed = files;
+    for (const ImageDecoder *decoder : ImageDecoder::decoders()) {
+        if (decoder == qt) {
+            continue;
+        }
+        QList<BenchFile> claimed;
+        for (auto it = unclaimed.begin(); it != unclaimed.end();) {
+            if (decoder->canDecode(it->magic)) {
+                claimed.append(*it);
+                it = unclaimed.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (claimed.isEmpty() || (parser.isSet(only) && parser.value(only) != QLatin1String(decoder->name()))) {
+            continue;
+        }
+        std::cout << claimed.size() << " files for " << decoder->name() << std::endl;
+        print(decoder->name(), run(decoder, claimed, targetSize, repeatCount));
+        print(qt->name(), run(qt, claimed, targetSize, repeatCount));
+    }
+    if (!unclaimed.isEmpty() && (!parser.isSet(only) || parser.value(only) == QLatin1String(qt->name()))) {
+        std::cout << unclaimed.size() << " files for " << qt->name() << " only" << std::endl;
+        print(qt->name(), run(qt, unclaimed, targetSize, repeatCount));
+    }
+    return 0;
+}
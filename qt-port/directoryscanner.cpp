@@ -0,0 +1,131 @@
+#include "directoryscanner.h"
+#include "fileindex.h"
+#include "trace.h"
+#include <QDirIterator>
+#include <QFileInfo>
+
+QRegularExpression DirectoryScanner::nameFilterExpression(const QStringList &nameFilters)
+{
+    QStringList patterns;
+    for (const auto &filter : nameFilters) {
+        patterns << "(?:" + QRegularExpression::wildcardToRegularExpression(filter) + ")";
+    }
+    QRegularExpression expression(patterns.join('|'), QRegularExpression::CaseInsensitiveOption);
+    expression.optimize();
+    return expression;
+}
+
+DirectoryScanner::DirectoryScanner(const QStringList &nameFilters, bool recursive, int threadCount, const FileIndex *index, QObject *parent)
+: QObject(parent),
+  m_nameFilter(nameFilterExpression(nameFilters)),
+  m_recursive(recursive),
+  m_index(index)
+{
+    if (m_index != nullptr) {
+        for (quint32 dir = 0; dir < m_index->directoryCount(); ++dir) {
+            m_indexedDirs.insert(m_index->directoryPath(dir), dir);
+        }
+    }
+    m_pool.setMaxThreadCount(std::max(1, threadCount));
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void DirectoryScanner::scan(const QStringList &roots)
+{
+    // directories of the index are checked along with the first scan
+    quint32 indexedCount = 0;
+    if (m_index != nullptr && !m_indexChecked) {
+        indexedCount = m_index->directoryCount();
+    }
+
+    QStringList newRoots;
+    for (const auto &root : roots) {
+        QString dirPath = QFileInfo(root).absoluteFilePath();
+        if (indexedCount == 0 || !m_indexedDirs.contains(dirPath)) {
+            newRoots << dirPath;
+        }
+    }
+
+    if (newRoots.isEmpty() && indexedCount == 0) {
+        QMetaObject::invokeMethod(this, &DirectoryScanner::finished, Qt::QueuedConnection);
+        return;
+    }
+
+    // count every directory first so the first finished one can't look like the end of the scan
+    m_pendingDirs += newRoots.size() + indexedCount;
+    m_indexChecked = true;
+    for (quint32 dir = 0; dir < indexedCount; ++dir) {
+        m_pool.start([this, dir]() { checkIndexedDirectory(dir); });
+    }
+    for (const auto &dirPath : newRoots) {
+        m_pool.start([this, dirPath]() { scanDirectory(dirPath); });
+    }
+}
+
+void DirectoryScanner::enqueue(const QString &dirPath)
+{
+    ++m_pendingDirs;
+    m_pool.start([this, dirPath]() { scanDirectory(dirPath); });
+}
+
+void DirectoryScanner::checkIndexedDirectory(quint32 indexedDir)
+{
+    TRACE_SCOPE("check indexed directory");
+    QString dirPath = m_index->directoryPath(indexedDir);
+    QFileInfo info(dirPath);
+    if (!info.isDir()) {
+        // removed since last run, its subdirectories are gone from the index too
+        finishDirectory();
+        return;
+    }
+    if (info.lastModified().toMSecsSinceEpoch() != m_index->directoryMTime(indexedDir)) {
+        scanDirectory(dirPath);
+        return;
+    }
+
+    ++m_unchangedDirs;
+    m_foundFiles += m_index->fileCount(indexedDir);
+    emit directoryUnchanged(indexedDir);
+    finishDirectory();
+}
+
+void DirectoryScanner::scanDirectory(const QString &dirPath)
+{
+    TRACE_SCOPE("scan directory");
+    // taken before listing so changes made during the listing show up next run
+    qint64 mtime = QFileInfo(dirPath).lastModified().toMSecsSinceEpoch();
+
+    QStringList fileNames;
+    QDirIterator it(dirPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        if (info.isDir()) {
+            // following directory links could walk in circles, indexed directories are checked on their own
+            if (m_recursive && !info.isSymLink() && !m_indexedDirs.contains(info.absoluteFilePath())) {
+                enqueue(info.absoluteFilePath());
+            }
+        } else if (m_nameFilter.match(info.fileName()).hasMatch()) {
+            fileNames << info.fileName();
+        }
+    }
+
+    // readdir order is arbitrary, the unshuffled show goes by name
+    fileNames.sort();
+    m_foundFiles += fileNames.size();
+    emit directoryScanned(dirPath, mtime, fileNames);
+    finishDirectory();
+}
+
+void DirectoryScanner::finishDirectory()
+{
+    ++m_scannedDirs;
+    if (--m_pendingDirs == 0) {
+        emit finished();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QRegularExpression>
+#include <QThreadPool>
+#include <QHash>
+#include <atomic>
+
+class FileIndex;
+
+// Walks directory trees on a thread pool, one task per directory, and reports
+// matching files directory by directory as soon as they are listed.
+// Given the index of a previous run, directories whose mtime did not change are
+// reported as unchanged without being listed again.
+class DirectoryScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    // the index must outlive the scanner
+    DirectoryScanner(const QStringList &nameFilters, bool recursive, int threadCount, const FileIndex *index = nullptr, QObject *parent = nullptr);
+    virtual ~DirectoryScanner();
+
+    static QRegularExpression nameFilterExpression(const QStringList &nameFilters);
+
+    // can be called again for directories appearing later, finished() is emitted after each scan
+    void scan(const QStringList &roots);
+
+    bool isFinished() const { return m_pendingDirs == 0; }
+    int pendingDirectories() const { return m_pendingDirs; }
+    int scannedDirectories() const { return m_scannedDirs; }
+    int unchangedDirectories() const { return m_unchangedDirs; }
+    int foundFiles() const { return m_foundFiles; }
+
+signals:
+    // emitted from worker threads
+    void directoryScanned(const QString &dirPath, qint64 mtime, const QStringList &fileNames);
+    void directoryUnchanged(quint32 indexedDir);
+    void finished();
+
+private:
+    void enqueue(const QString &dirPath);
+    void checkIndexedDirectory(quint32 indexedDir);
+    void scanDirectory(const QString &dirPath);
+    void finishDirectory();
+
+    QRegularExpression m_nameFilter;
+    bool m_recursive;
+    QThreadPool m_pool;
+
+    const FileIndex *m_index;
+    QHash<QString, quint32> m_indexedDirs;
+    bool m_indexChecked = false;
+
+    std::atomic<int> m_pendingDirs{0};
+    std::atomic<int> m_scannedDirs{0};
+    std::atomic<int> m_unchangedDirs{0};
+    std::atomic<int> m_foundFiles{0};
+};
@@ -0,0 +1,207 @@
+#include "exifpreview.h"
+#include "imagedecoder.h"
+#include "imageutil.h"
+#include <QImage>
+#include <QImageReader>
+#include <QBuffer>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// APP1 segments are at most 64 KiB and come before the frame header, which follows a few
+// tables; this much of the file holds both for camera JPEGs
+static const qint64 kHeadBytes = 128 * 1024;
+// files below this are read whole about as fast as their head
+static const qint64 kMinFileBytes = 4 * kHeadBytes;
+// previews are shown at least at half their size, smaller ones are too blurry to bother
+static const int kMaxPreviewUpscale = 2;
+
+namespace {
+
+// bounds-checked reads of the big or little endian values of a TIFF structure
+class TiffReader
+{
+public:
+    TiffReader(const uchar *data, qint64 size)
+    : m_data(data),
+      m_size(size)
+    {
+        if (size >= 8 && data[0] == 'I' && data[1] == 'I') {
+            m_littleEndian = true;
+        } else if (size < 8 || data[0] != 'M' || data[1] != 'M') {
+            m_size = 0;
+        }
+    }
+
+    bool isValid() const { return m_size != 0 && u16(2) == 42; }
+    qint64 size() const { return m_size; }
+    const uchar *data() const { return m_data; }
+
+    quint32 u16(qint64 offset) const
+    {
+        if (offset < 0 || offset + 2 > m_size) {
+            return 0;
+        }
+        return m_littleEndian ? m_data[offset] | m_data[offset + 1] << 8
+                              : m_data[offset] << 8 | m_data[offset + 1];
+    }
+
+    quint32 u32(qint64 offset) const
+    {
+        if (offset < 0 || offset + 4 > m_size) {
+            return 0;
+        }
+        return m_littleEndian ? u16(offset) | u16(offset + 2) << 16 : u16(offset) << 16 | u16(offset + 2);
+    }
+
+private:
+    const uchar *m_data;
+    qint64 m_size;
+    bool m_littleEndian = false;
+};
+
+// an embedded JPEG, as an offset and length in the file
+struct EmbeddedJpeg {
+    qint64 offset;
+    qint64 length;
+};
+
+// the JPEG of IFD1, the thumbnail IFD, as an offset and length in the TIFF structure
+bool findThumbnail(const TiffReader &tiff, qint64 *offset, qint64 *length)
+{
+    qint64 ifd0 = tiff.u32(4);
+    qint64 ifd1 = tiff.u32(ifd0 + 2 + qint64(tiff.u16(ifd0)) * 12);
+    if (ifd0 == 0 || ifd1 == 0) {
+        return false;
+    }
+    *offset = 0;
+    *length = 0;
+    quint32 count = tiff.u16(ifd1);
+    for (quint32 i = 0; i < count; ++i) {
+        qint64 entry = ifd1 + 2 + qint64(i) * 12;
+        switch (tiff.u16(entry)) {
+        case 0x0201: // JPEGInterchangeFormat
+            *offset = tiff.u32(entry + 8);
+            break;
+        case 0x0202: // JPEGInterchangeFormatLength
+            *length = tiff.u32(entry + 8);
+            break;
+        }
+    }
+    return *offset > 0 && *length > 0 && *offset + *length <= tiff.size();
+}
+
+// the large thumbnails of the Multi-Picture Format index in APP2, which cameras add after
+// the image itself at up to full HD; offsets are from the start of the MPF TIFF structure
+void findLargeThumbnails(const TiffReader &mpf, qint64 mpfOffset, qint64 fileSize, std::vector<EmbeddedJpeg> *jpegs)
+{
+    qint64 ifd = mpf.u32(4);
+    quint32 count = mpf.u16(ifd);
+    for (quint32 i = 0; i < count; ++i) {
+        qint64 entry = ifd + 2 + qint64(i) * 12;
+        if (mpf.u16(entry) != 0xB002) { // MPEntry, 16 bytes per image
+            continue;
+        }
+        qint64 entries = mpf.u32(entry + 8);
+        qint64 images = mpf.u32(entry + 4) / 16;
+        // the first image is the primary one
+        for (qint64 image = 1; image < images; ++image) {
+            qint64 record = entries + image * 16;
+            quint32 type = mpf.u32(record) & 0xFFFFFF;
+            qint64 length = mpf.u32(record + 4);
+            qint64 offset = mpfOffset + mpf.u32(record + 8);
+            // VGA and full HD large thumbnails
+            if ((type == 0x010001 || type == 0x010002) && length > 0 && offset > mpfOffset && offset + length <= fileSize) {
+                jpegs->push_back(EmbeddedJpeg{ offset, length });
+            }
+        }
+    }
+}
+
+}
+
+ImagePreview readExifPreview(const FileData &file, const QSize &targetSize)
+{
+    if (file.isNull() || file.size() < kMinFileBytes) {
+        return ImagePreview();
+    }
+    const uchar *data = file.data();
+    qint64 size = std::min(file.size(), kHeadBytes);
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return ImagePreview();
+    }
+
+    // walk the segments up to the frame header, picking the embedded JPEGs up on the way
+    std::vector<EmbeddedJpeg> jpegs;
+    QSize fullSize;
+    qint64 pos = 2;
+    while (pos + 4 <= size && !fullSize.isValid()) {
+        if (data[pos] != 0xFF) {
+            return ImagePreview();
+        }
+        uchar marker = data[pos + 1];
+        if (marker == 0xFF) {
+            // fill byte
+            ++pos;
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) {
+            break;
+        }
+        qint64 length = data[pos + 2] << 8 | data[pos + 3];
+        const uchar *segment = data + pos + 4;
+        qint64 segmentSize = std::min(length - 2, size - pos - 4);
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (segmentSize >= 5) {
+                fullSize = QSize(segment[3] << 8 | segment[4], segment[1] << 8 | segment[2]);
+            }
+        } else if (marker == 0xE1 && segmentSize > 6 && std::memcmp(segment, "Exif\0\0", 6) == 0) {
+            TiffReader tiff(segment + 6, segmentSize - 6);
+            qint64 offset, thumbnailLength;
+            if (tiff.isValid() && findThumbnail(tiff, &offset, &thumbnailLength)) {
+                jpegs.push_back(EmbeddedJpeg{ pos + 4 + 6 + offset, thumbnailLength });
+            }
+        } else if (marker == 0xE2 && segmentSize > 4 && std::memcmp(segment, "MPF\0", 4) == 0) {
+            TiffReader mpf(segment + 4, segmentSize - 4);
+            if (mpf.isValid()) {
+                findLargeThumbnails(mpf, pos + 4 + 4, file.size(), &jpegs);
+            }
+        }
+        pos += 2 + length;
+    }
+    if (jpegs.empty() || fullSize.isEmpty()) {
+        return ImagePreview();
+    }
+
+    // the largest one first, only its header is read before it is known to be good enough
+    std::sort(jpegs.begin(), jpegs.end(), [](const EmbeddedJpeg &a, const EmbeddedJpeg &b) { return a.length > b.length; });
+    int shownWidth = fullSize.width();
+    int shownHeight = fullSize.height();
+    if (targetSize.isValid() && (shownWidth > targetSize.width() || shownHeight > targetSize.height())) {
+        std::tie(shownWidth, shownHeight) = scaleToFit(shownWidth, shownHeight, targetSize.width(), targetSize.height());
+    }
+    for (const EmbeddedJpeg &jpeg : jpegs) {
+        QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data + jpeg.offset), jpeg.length);
+        QBuffer buffer(&bytes);
+        QImageReader reader(&buffer, "JPEG");
+        QSize size = reader.size();
+        if (!size.isValid() || size.width() * kMaxPreviewUpscale < shownWidth || size.height() * kMaxPreviewUpscale < shownHeight) {
+            // sorted by bytes, a smaller one won't do either
+            break;
+        }
+        // letterboxed or cropped thumbnails would jump when the full image replaces them
+        if (std::abs(qint64(size.width()) * fullSize.height() - qint64(size.height()) * fullSize.width()) * 50 > qint64(size.width()) * fullSize.height()) {
+            continue;
+        }
+        QImage image = reader.read();
+        if (image.isNull()) {
+            continue;
+        }
+        ImagePreview preview;
+        preview.image = DecodedImage(image);
+        preview.fullSize = fullSize;
+        return preview;
+    }
+    return ImagePreview();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "decodedimage.h"
+#include <QSize>
+
+class FileData;
+
+// The preview a camera embeds in a JPEG, shown while the full image is still being read
+// and decoded, along with the size of the full image it stands for: a large thumbnail of
+// the Multi-Picture Format index, or else the thumbnail of the EXIF APP1 segment.
+struct ImagePreview
+{
+    bool isNull() const { return image.isNull(); }
+
+    DecodedImage image;
+    QSize fullSize;
+};
+
+// only touches the head of the file and the preview; null when it has no embedded preview,
+// when the preview would be shown at more than twice its size in targetSize, when it
+// doesn't have the shape of the image (letterboxed thumbnails) or when the file is small
+// enough for the full decode not to be worth waiting for
+ImagePreview readExifPreview(const FileData &file, const QSize &targetSize);
@@ -0,0 +1,176 @@
+#include "fileindex.h"
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <cstring>
+
+static const char kIndexMagic[4] = { 'S', 'S', 'I', 'X' };
+static const quint32 kIndexVersion = 1;
+
+static_assert(sizeof(IndexHeader) == 32 && sizeof(IndexDirectory) == 32 && sizeof(IndexFile) == 12,
+              "records are read straight from the mapping");
+
+bool FileIndex::open(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = m_file.size();
+    const uchar *data = size >= qint64(sizeof(IndexHeader)) ? m_file.map(0, size) : nullptr;
+    if (data == nullptr) {
+        m_file.close();
+        return false;
+    }
+
+    auto header = reinterpret_cast<const IndexHeader*>(data);
+    if (!isValid(header, size)) {
+        m_file.close();
+        return false;
+    }
+
+    m_header = header;
+    m_dirs = reinterpret_cast<const IndexDirectory*>(data + sizeof(IndexHeader));
+    m_files = reinterpret_cast<const IndexFile*>(m_dirs + header->directoryCount);
+    m_strings = reinterpret_cast<const char*>(m_files + header->fileCount);
+    return true;
+}
+
+// the records are read without checks later on, a truncated or corrupt file is rejected
+// here rather than read out of the mapping
+bool FileIndex::isValid(const IndexHeader *header, qint64 size)
+{
+    if (std::memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header->version != kIndexVersion ||
+        header->stringBytes > quint64(size)) {
+        return false;
+    }
+    qint64 expectedSize = sizeof(IndexHeader) + qint64(header->directoryCount) * sizeof(IndexDirectory) +
+                          qint64(header->fileCount) * sizeof(IndexFile) + qint64(header->stringBytes);
+    if (expectedSize != size) {
+        return false;
+    }
+
+    auto dirs = reinterpret_cast<const IndexDirectory*>(header + 1);
+    auto files = reinterpret_cast<const IndexFile*>(dirs + header->directoryCount);
+    quint64 stringBytes = header->stringBytes;
+    for (quint32 dir = 0; dir < header->directoryCount; ++dir) {
+        const IndexDirectory &record = dirs[dir];
+        if (quint64(record.pathOffset) + record.pathLength > stringBytes ||
+            quint64(record.firstFile) + record.fileCount > header->fileCount) {
+            return false;
+        }
+        for (quint32 file = record.firstFile; file < record.firstFile + record.fileCount; ++file) {
+            if (files[file].directory != dir) {
+                return false;
+            }
+        }
+    }
+    for (quint32 file = 0; file < header->fileCount; ++file) {
+        const IndexFile &record = files[file];
+        if (record.directory >= header->directoryCount || quint64(record.nameOffset) + record.nameLength > stringBytes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+quint32 FileIndex::directoryCount() const
+{
+    return m_header != nullptr ? m_header->directoryCount : 0;
+}
+
+QByteArrayView FileIndex::directoryPathUtf8(quint32 dir) const
+{
+    return QByteArrayView(m_strings + m_dirs[dir].pathOffset, m_dirs[dir].pathLength);
+}
+
+QString FileIndex::directoryPath(quint32 dir) const
+{
+    return QString::fromUtf8(directoryPathUtf8(dir));
+}
+
+qint64 FileIndex::directoryMTime(quint32 dir) const
+{
+    return m_dirs[dir].mtime;
+}
+
+quint32 FileIndex::firstFile(quint32 dir) const
+{
+    return m_dirs[dir].firstFile;
+}
+
+quint32 FileIndex::fileCount(quint32 dir) const
+{
+    return m_dirs[dir].fileCount;
+}
+
+quint32 FileIndex::fileCount() const
+{
+    return m_header != nullptr ? m_header->fileCount : 0;
+}
+
+QByteArrayView FileIndex::fileNameUtf8(quint32 file) const
+{
+    return QByteArrayView(m_strings + m_files[file].nameOffset, m_files[file].nameLength);
+}
+
+quint32 FileIndex::fileDirectory(quint32 file) const
+{
+    return m_files[file].directory;
+}
+
+QString FileIndex::filePath(quint32 file) const
+{
+    return directoryPath(m_files[file].directory) + '/' + QString::fromUtf8(fileNameUtf8(file));
+}
+
+void FileIndexWriter::addDirectory(QByteArrayView pathUtf8, qint64 mtime)
+{
+    IndexDirectory dir = {};
+    dir.mtime = mtime;
+    dir.pathOffset = addString(pathUtf8);
+    dir.pathLength = pathUtf8.size();
+    dir.firstFile = m_files.size();
+    m_dirs.push_back(dir);
+}
+
+void FileIndexWriter::addFile(QByteArrayView nameUtf8)
+{
+    IndexFile file;
+    file.directory = m_dirs.size() - 1;
+    file.nameOffset = addString(nameUtf8);
+    file.nameLength = nameUtf8.size();
+    m_files.push_back(file);
+    m_dirs.back().fileCount += 1;
+}
+
+quint32 FileIndexWriter::addString(QByteArrayView str)
+{
+    quint32 offset = m_strings.size();
+    m_strings.append(str);
+    return offset;
+}
+
+bool FileIndexWriter::save(const QString &path) const
+{
+    IndexHeader header = {};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.directoryCount = m_dirs.size();
+    header.fileCount = m_files.size();
+    header.stringBytes = m_strings.size();
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // the previous index may still be mapped, it is replaced rather than overwritten
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(m_dirs.data()), m_dirs.size() * sizeof(IndexDirectory));
+    out.write(reinterpret_cast<const char*>(m_files.data()), m_files.size() * sizeof(IndexFile));
+    out.write(m_strings.constData(), m_strings.size());
+    return out.commit();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <vector>
+
+// On-disk layout: header, directory records, file records, then UTF-8 strings.
+struct IndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 directoryCount;
+    quint32 fileCount;
+    quint64 stringBytes;
+    quint64 reserved;
+};
+
+struct IndexDirectory {
+    qint64 mtime;           // msecs since epoch
+    quint32 pathOffset;
+    quint32 pathLength;
+    quint32 firstFile;
+    quint32 fileCount;
+    quint64 reserved;
+};
+
+struct IndexFile {
+    quint32 directory;
+    quint32 nameOffset;
+    quint32 nameLength;
+};
+
+// Read-only view of a file list saved by FileIndexWriter. The file is memory-mapped
+// and read in place, paths are only turned into QString when asked for.
+class FileIndex
+{
+public:
+    FileIndex() = default;
+    FileIndex(const FileIndex &) = delete;
+    FileIndex& operator=(const FileIndex &) = delete;
+
+    bool open(const QString &path);
+    bool isOpen() const { return m_header != nullptr; }
+
+    quint32 directoryCount() const;
+    QByteArrayView directoryPathUtf8(quint32 dir) const;
+    QString directoryPath(quint32 dir) const;
+    qint64 directoryMTime(quint32 dir) const;
+    // files of a directory have consecutive ids
+    quint32 firstFile(quint32 dir) const;
+    quint32 fileCount(quint32 dir) const;
+
+    quint32 fileCount() const;
+    QByteArrayView fileNameUtf8(quint32 file) const;
+    quint32 fileDirectory(quint32 file) const;
+    QString filePath(quint32 file) const;
+
+private:
+    static bool isValid(const IndexHeader *header, qint64 size);
+
+    QFile m_file;
+    const IndexHeader *m_header = nullptr;
+    const IndexDirectory *m_dirs = nullptr;
+    const IndexFile *m_files = nullptr;
+    const char *m_strings = nullptr;
+};
+
+class FileIndexWriter
+{
+public:
+    void addDirectory(QByteArrayView pathUtf8, qint64 mtime);
+    // adds a file to the last added directory
+    void addFile(QByteArrayView nameUtf8);
+    bool save(const QString &path) const;
+
+private:
+    quint32 addString(QByteArrayView str);
+
+    std::vector<IndexDirectory> m_dirs;
+    std::vector<IndexFile> m_files;
+    QByteArray m_strings;
+};
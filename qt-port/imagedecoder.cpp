@@ -0,0 +1,90 @@
+#include "imagedecoder.h"
+#include "qtimagedecoder.h"
+#ifdef HAVE_TURBOJPEG
+#include "turbojpegdecoder.h"
+#endif
+#ifdef HAVE_LIBPNG
+#include "pngdecoder.h"
+#endif
+#ifdef HAVE_LIBWEBP
+#include "webpdecoder.h"
+#endif
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+const std::vector<const ImageDecoder*> &ImageDecoder::decoders()
+{
+    static const std::vector<const ImageDecoder*> all = {
+#ifdef HAVE_TURBOJPEG
+        new TurboJpegDecoder(),
+#endif
+#ifdef HAVE_LIBPNG
+        new PngDecoder(),
+#endif
+#ifdef HAVE_LIBWEBP
+        new WebpDecoder(),
+#endif
+        new QtImageDecoder(),
+    };
+    return all;
+}
+
+const ImageDecoder *ImageDecoder::find(const QString &name)
+{
+    for (const ImageDecoder *decoder : decoders()) {
+        if (name == QLatin1String(decoder->name())) {
+            return decoder;
+        }
+    }
+    return nullptr;
+}
+
+QByteArray ImageDecoder::readMagic(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.read(kMagicBytes);
+}
+
+FileData::FileData(const QString &filePath, const QByteArray &contents)
+: m_path(filePath),
+  m_file(filePath)
+{
+    if (!contents.isEmpty()) {
+        m_contents = contents;
+        m_data = reinterpret_cast<const uchar*>(m_contents.constData());
+        m_size = m_contents.size();
+        return;
+    }
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() == 0) {
+        return;
+    }
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (m_data == nullptr) {
+        m_contents = m_file.readAll();
+        m_data = m_contents.isEmpty() ? nullptr : reinterpret_cast<const uchar*>(m_contents.constData());
+        m_size = m_contents.size();
+    }
+}
+
+QByteArray FileData::magic() const
+{
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), int(std::min<qint64>(m_size, ImageDecoder::kMagicBytes)));
+}
+
+void FileData::prefetch() const
+{
+#ifdef Q_OS_UNIX
+    if (m_data != nullptr && m_contents.isEmpty()) {
+        // the mapping starts at offset 0, so on a page boundary
+        void *address = const_cast<uchar*>(m_data);
+        madvise(address, size_t(m_size), MADV_SEQUENTIAL);
+        madvise(address, size_t(m_size), MADV_WILLNEED);
+    }
+#endif
+}
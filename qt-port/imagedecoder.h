@@ -0,0 +1,63 @@
+#pragma once
+
+#include "decodedimage.h"
+#include <QByteArray>
+#include <QFile>
+#include <QSize>
+#include <QString>
+#include <vector>
+
+class FileData;
+
+// A way of decoding images, picked for a file by the magic bytes it starts with rather
+// than by its extension. Decoders hold no state, one instance is shared by every thread.
+class ImageDecoder
+{
+public:
+    // enough of the start of a file for every decoder to recognize its format
+    static const int kMagicBytes = 16;
+
+    virtual ~ImageDecoder() = default;
+
+    virtual const char *name() const = 0;
+    // whether a file starting with these bytes is one the decoder reads, magic holds fewer
+    // than kMagicBytes only for shorter files
+    virtual bool canDecode(const QByteArray &magic) const = 0;
+    // the full size of the image, invalid when it can't be told without decoding
+    virtual QSize imageSize(const FileData &file) const = 0;
+    // decodes to scaledSize when valid, or as close above it as the decoder can scale;
+    // null when the file can't be decoded, so that the next decoder can be tried
+    virtual DecodedImage decode(const FileData &file, const QSize &scaledSize) const = 0;
+
+    // every decoder built in, native ones first, the one going through Qt's plugins last
+    static const std::vector<const ImageDecoder*> &decoders();
+    static const ImageDecoder *find(const QString &name);
+    static QByteArray readMagic(const QString &filePath);
+};
+
+// The contents of a file, memory-mapped so that decoders read the page cache in place
+// instead of copies of it, or read whole when the file can't be mapped. Pages are only
+// read as they are touched until prefetch().
+class FileData
+{
+public:
+    // contents read already, by the read-ahead, are used as they are instead
+    explicit FileData(const QString &filePath, const QByteArray &contents = QByteArray());
+
+    bool isNull() const { return m_data == nullptr; }
+    const QString &path() const { return m_path; }
+    const uchar *data() const { return m_data; }
+    qint64 size() const { return m_size; }
+    // the first bytes, for ImageDecoder::canDecode()
+    QByteArray magic() const;
+    // the whole file is about to be read through: the kernel reads the rest of it ahead
+    // in the background, and may drop pages once they were read
+    void prefetch() const;
+
+private:
+    QString m_path;
+    QFile m_file;
+    QByteArray m_contents;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+};
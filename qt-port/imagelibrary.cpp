@@ -0,0 +1,251 @@
+#include "imagelibrary.h"
+#include <algorithm>
+
+bool ImageLibrary::openIndex(const QString &indexPath)
+{
+    return m_index.open(indexPath);
+}
+
+ImageLibrary::Range ImageLibrary::addIndexedDirectory(quint32 indexedDir)
+{
+    m_keptIndexedDirs.push_back(indexedDir);
+    m_dirsByPath[m_index.directoryPath(indexedDir)].append(DirectoryRef{ true, indexedDir });
+    Range range{ m_index.firstFile(indexedDir), m_index.fileCount(indexedDir) };
+    markAvailable(range);
+    return range;
+}
+
+ImageLibrary::Range ImageLibrary::addScannedDirectory(const QString &dirPath, qint64 mtime, const QStringList &fileNames)
+{
+    // a directory showing up again (moved away and back) must not duplicate its images
+    if (m_dirsByPath.contains(dirPath)) {
+        return addFiles(dirPath, fileNames);
+    }
+    return addDirectory(dirPath, mtime, fileNames, false);
+}
+
+ImageLibrary::Range ImageLibrary::addFiles(const QString &dirPath, const QStringList &fileNames)
+{
+    QHash<QString, quint32> &known = imagesIn(dirPath);
+    QStringList newNames;
+    for (const auto &fileName : fileNames) {
+        if (!known.contains(fileName) && !newNames.contains(fileName)) {
+            newNames << fileName;
+        }
+    }
+    if (newNames.isEmpty()) {
+        return Range{ count(), 0 };
+    }
+    Range range = addDirectory(dirPath, 0, newNames, true);
+    for (quint32 i = 0; i < range.count; ++i) {
+        known.insert(newNames[i], range.first + i);
+    }
+    return range;
+}
+
+void ImageLibrary::removeFiles(const QString &dirPath, const QStringList &fileNames)
+{
+    if (!m_dirsByPath.contains(dirPath)) {
+        return;
+    }
+    QHash<QString, quint32> &known = imagesIn(dirPath);
+    for (const auto &fileName : fileNames) {
+        auto it = known.find(fileName);
+        if (it != known.end()) {
+            markRemoved(it.value());
+            known.erase(it);
+        }
+    }
+}
+
+void ImageLibrary::removeDirectoryTree(const QString &dirPath)
+{
+    // the directory itself, then its subdirectories, which sort together right after the prefix
+    auto removeDirectory = [this](QMap<QString, QList<DirectoryRef>>::iterator it) {
+        for (const auto &ref : it.value()) {
+            Range range = ref.indexed ? Range{ m_index.firstFile(ref.dir), m_index.fileCount(ref.dir) }
+                                      : Range{ m_scannedDirs[ref.dir].firstId, m_scannedDirs[ref.dir].fileCount };
+            for (quint32 id = range.first; id < range.first + range.count; ++id) {
+                markRemoved(id);
+            }
+        }
+        m_imagesByDir.remove(it.key());
+        return m_dirsByPath.erase(it);
+    };
+    auto it = m_dirsByPath.find(dirPath);
+    if (it != m_dirsByPath.end()) {
+        removeDirectory(it);
+    }
+    QString prefix = dirPath + '/';
+    for (it = m_dirsByPath.lowerBound(prefix); it != m_dirsByPath.end() && it.key().startsWith(prefix);) {
+        it = removeDirectory(it);
+    }
+}
+
+ImageLibrary::Range ImageLibrary::addDirectory(const QString &dirPath, qint64 mtime, const QStringList &fileNames, bool live)
+{
+    quint32 dir = m_scannedDirs.size();
+    Range range{ count(), quint32(fileNames.size()) };
+    quint32 pathOffset = addString(dirPath);
+    m_scannedDirs.push_back(ScannedDirectory{ mtime, pathOffset, quint32(m_strings.size()) - pathOffset, range.first, range.count, live });
+    m_dirsByPath[dirPath].append(DirectoryRef{ false, dir });
+
+    for (const auto &fileName : fileNames) {
+        quint32 nameOffset = addString(fileName);
+        m_scannedFiles.push_back(ScannedFile{ dir, nameOffset, quint32(m_strings.size()) - nameOffset });
+    }
+    markAvailable(range);
+    return range;
+}
+
+quint32 ImageLibrary::addString(const QString &str)
+{
+    quint32 offset = m_strings.size();
+    m_strings.append(str.toUtf8());
+    return offset;
+}
+
+QHash<QString, quint32> &ImageLibrary::imagesIn(const QString &dirPath)
+{
+    auto cached = m_imagesByDir.find(dirPath);
+    if (cached != m_imagesByDir.end()) {
+        return cached.value();
+    }
+    QHash<QString, quint32> &images = m_imagesByDir[dirPath];
+    for (const auto &ref : m_dirsByPath.value(dirPath)) {
+        if (ref.indexed) {
+            quint32 end = m_index.firstFile(ref.dir) + m_index.fileCount(ref.dir);
+            for (quint32 file = m_index.firstFile(ref.dir); file < end; ++file) {
+                if (isAvailable(file)) {
+                    images.insert(QString::fromUtf8(m_index.fileNameUtf8(file)), file);
+                }
+            }
+        } else {
+            const auto &dir = m_scannedDirs[ref.dir];
+            for (quint32 id = dir.firstId; id < dir.firstId + dir.fileCount; ++id) {
+                if (isAvailable(id)) {
+                    const auto &file = m_scannedFiles[id - m_index.fileCount()];
+                    images.insert(QString::fromUtf8(stringAt(file.nameOffset, file.nameLength)), id);
+                }
+            }
+        }
+    }
+    return images;
+}
+
+void ImageLibrary::markAvailable(Range range)
+{
+    if (m_available.size() < count()) {
+        m_available.resize(count());
+    }
+    for (quint32 id = range.first; id < range.first + range.count; ++id) {
+        if (!m_available[id]) {
+            m_available[id] = true;
+            ++m_availableCount;
+        }
+    }
+}
+
+void ImageLibrary::markRemoved(quint32 id)
+{
+    if (isAvailable(id)) {
+        m_available[id] = false;
+        --m_availableCount;
+    }
+}
+
+QString ImageLibrary::path(quint32 id) const
+{
+    if (id < m_index.fileCount()) {
+        return m_index.filePath(id);
+    }
+    const auto &file = m_scannedFiles[id - m_index.fileCount()];
+    const auto &dir = m_scannedDirs[file.directory];
+    return QString::fromUtf8(stringAt(dir.pathOffset, dir.pathLength)) + '/' + QString::fromUtf8(stringAt(file.nameOffset, file.nameLength));
+}
+
+QByteArrayView ImageLibrary::directoryUtf8(quint32 id) const
+{
+    if (id < m_index.fileCount()) {
+        return m_index.directoryPathUtf8(m_index.fileDirectory(id));
+    }
+    const auto &dir = m_scannedDirs[m_scannedFiles[id - m_index.fileCount()].directory];
+    return stringAt(dir.pathOffset, dir.pathLength);
+}
+
+QByteArrayView ImageLibrary::nameUtf8(quint32 id) const
+{
+    if (id < m_index.fileCount()) {
+        return m_index.fileNameUtf8(id);
+    }
+    const auto &file = m_scannedFiles[id - m_index.fileCount()];
+    return stringAt(file.nameOffset, file.nameLength);
+}
+
+// UTF-8 bytes compare in code point order; '/' goes before anything else so that a
+// directory comes right before its own subdirectories
+static int comparePaths(QByteArrayView a, QByteArrayView b)
+{
+    qsizetype length = std::min(a.size(), b.size());
+    for (qsizetype i = 0; i < length; ++i) {
+        uchar ca = uchar(a[i]) == '/' ? 0 : uchar(a[i]);
+        uchar cb = uchar(b[i]) == '/' ? 0 : uchar(b[i]);
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+bool ImageLibrary::pathLess(quint32 a, quint32 b) const
+{
+    int dirs = comparePaths(directoryUtf8(a), directoryUtf8(b));
+    if (dirs != 0) {
+        return dirs < 0;
+    }
+    return comparePaths(nameUtf8(a), nameUtf8(b)) < 0;
+}
+
+bool ImageLibrary::saveIndex(const QString &indexPath) const
+{
+    // changes seen while watching are left out, they changed the mtime of their
+    // directory so the next run lists it again anyway
+    FileIndexWriter writer;
+    for (quint32 dir : m_keptIndexedDirs) {
+        writer.addDirectory(m_index.directoryPathUtf8(dir), m_index.directoryMTime(dir));
+        quint32 end = m_index.firstFile(dir) + m_index.fileCount(dir);
+        for (quint32 file = m_index.firstFile(dir); file < end; ++file) {
+            writer.addFile(m_index.fileNameUtf8(file));
+        }
+    }
+    for (const auto &dir : m_scannedDirs) {
+        if (dir.live) {
+            continue;
+        }
+        writer.addDirectory(stringAt(dir.pathOffset, dir.pathLength), dir.mtime);
+        for (quint32 id = dir.firstId; id < dir.firstId + dir.fileCount; ++id) {
+            const auto &file = m_scannedFiles[id - m_index.fileCount()];
+            writer.addFile(stringAt(file.nameOffset, file.nameLength));
+        }
+    }
+    return writer.save(indexPath);
+}
+
+size_t ImageLibrary::memoryUsage() const
+{
+    size_t bytes = m_strings.capacity() +
+                   m_scannedDirs.capacity() * sizeof(ScannedDirectory) +
+                   m_scannedFiles.capacity() * sizeof(ScannedFile) +
+                   m_keptIndexedDirs.capacity() * sizeof(quint32) +
+                   m_available.capacity() / 8;
+    for (auto it = m_dirsByPath.cbegin(); it != m_dirsByPath.cend(); ++it) {
+        bytes += sizeof(QString) + it.key().capacity() * sizeof(QChar) + it.value().capacity() * sizeof(DirectoryRef);
+    }
+    for (auto it = m_imagesByDir.cbegin(); it != m_imagesByDir.cend(); ++it) {
+        bytes += sizeof(QString) + it.key().capacity() * sizeof(QChar);
+        for (auto image = it.value().cbegin(); image != it.value().cend(); ++image) {
+            bytes += sizeof(QString) + sizeof(quint32) + image.key().capacity() * sizeof(QChar);
+        }
+    }
+    return bytes;
+}
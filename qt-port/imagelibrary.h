@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include "fileindex.h"
+#include <vector>
+
+// All images known to the show, each identified by a 32-bit id, shared by every order
+// built on top of it. Images of directories unchanged since the last run are read in
+// place from the mapped file index. Directories scanned in this run are stored the same
+// way in memory: one record per directory and UTF-8 names packed in a single buffer.
+// Ids are only available once their directory has been reported by the scan. Removed
+// images keep their id and are only flagged, so removal costs nothing to the orders
+// built on top of the ids, which simply skip unavailable ones. The names of a directory
+// are looked up by a map built the first time files of it are added or removed while
+// the show runs, and kept up to date after that, so later changes cost what they touch.
+class ImageLibrary
+{
+public:
+    struct Range {
+        quint32 first;
+        quint32 count;
+    };
+
+    bool openIndex(const QString &indexPath);
+    const FileIndex *index() const { return m_index.isOpen() ? &m_index : nullptr; }
+
+    Range addIndexedDirectory(quint32 indexedDir);
+    Range addScannedDirectory(const QString &dirPath, qint64 mtime, const QStringList &fileNames);
+    // files seen appearing while the show runs, ones already known are skipped
+    Range addFiles(const QString &dirPath, const QStringList &fileNames);
+    void removeFiles(const QString &dirPath, const QStringList &fileNames);
+    void removeDirectoryTree(const QString &dirPath);
+
+    // ids range over [0, count()), some of them may not be available
+    quint32 count() const { return m_index.fileCount() + m_scannedFiles.size(); }
+    quint32 availableCount() const { return m_availableCount; }
+    bool isAvailable(quint32 id) const { return id < m_available.size() && m_available[id]; }
+    QString path(quint32 id) const;
+    // in the order of a depth-first walk visiting names in sorted order, files of a
+    // directory before its subdirectories
+    bool pathLess(quint32 a, quint32 b) const;
+
+    bool saveIndex(const QString &indexPath) const;
+    // heap bytes held for this run's directories, the mapped index not included
+    size_t memoryUsage() const;
+
+private:
+    struct ScannedDirectory {
+        qint64 mtime;
+        quint32 pathOffset;
+        quint32 pathLength;
+        quint32 firstId;
+        quint32 fileCount;
+        bool live;          // added by watching, not saved to the index
+    };
+
+    struct ScannedFile {
+        quint32 directory;
+        quint32 nameOffset;
+        quint32 nameLength;
+    };
+
+    struct DirectoryRef {
+        bool indexed;
+        quint32 dir;
+    };
+
+    Range addDirectory(const QString &dirPath, qint64 mtime, const QStringList &fileNames, bool live);
+    quint32 addString(const QString &str);
+    QByteArrayView stringAt(quint32 offset, quint32 length) const { return QByteArrayView(m_strings.constData() + offset, length); }
+    QHash<QString, quint32> &imagesIn(const QString &dirPath);
+    QByteArrayView directoryUtf8(quint32 id) const;
+    QByteArrayView nameUtf8(quint32 id) const;
+    void markAvailable(Range range);
+    void markRemoved(quint32 id);
+
+    FileIndex m_index;
+    std::vector<quint32> m_keptIndexedDirs;
+    std::vector<ScannedDirectory> m_scannedDirs;
+    std::vector<ScannedFile> m_scannedFiles;    // ids following the ones of the index
+    QByteArray m_strings;
+    QMap<QString, QList<DirectoryRef>> m_dirsByPath;   // sorted, a tree is a range of it
+    QHash<QString, QHash<QString, quint32>> m_imagesByDir; // available images by name, of the directories that changed
+    std::vector<bool> m_available;
+    quint32 m_availableCount = 0;
+};
@@ -0,0 +1,302 @@
+#include "imageloader.h"
+#include <QElapsedTimer>
+#include "imageutil.h"
+#include "previewcache.h"
+#include "imagelibrary.h"
+#include "showorder.h"
+#include "imagedecoder.h"
+#include "readahead.h"
+#include "resampler.h"
+#include "trace.h"
+#include <algorithm>
+#include <iostream>
+
+// tries the decoders reading the format of the file in turn, the first one that decodes it wins;
+// the preview cache was looked up already, downscaled images are stored in it
+static DecodedImage decodeImage(const FileData &file, const QSize &targetSize, PreviewCache *previewCache)
+{
+    if (file.isNull()) {
+        return DecodedImage();
+    }
+    const QString &filePath = file.path();
+    QByteArray magic = file.magic();
+    for (const ImageDecoder *decoder : ImageDecoder::decoders()) {
+        if (!decoder->canDecode(magic)) {
+            continue;
+        }
+        QSize size = decoder->imageSize(file);
+        bool downscale = size.isValid() && targetSize.isValid() && (size.width() > targetSize.width() || size.height() > targetSize.height());
+        QSize scaledSize;
+        if (downscale) {
+            int w, h;
+            std::tie(w, h) = scaleToFit(size.width(), size.height(), targetSize.width(), targetSize.height());
+            scaledSize = QSize(std::max(1, w), std::max(1, h));
+        }
+
+        // only headers were read so far, the rest is read in one go
+        {
+            TRACE_SCOPE("read file");
+            file.prefetch();
+        }
+        DecodedImage image;
+        {
+            TRACE_SCOPE("decode");
+            image = decoder->decode(file, scaledSize);
+        }
+        if (image.isNull()) {
+            continue;
+        }
+        // planes stay at the size the decoder could scale to, the GPU takes them the rest of the way;
+        // pixels are averaged down to the size they are shown at here, on the decode thread
+        if (downscale && !image.isPlanar() && (image.width() > scaledSize.width() || image.height() > scaledSize.height())) {
+            TRACE_SCOPE("downscale");
+            image = DecodedImage(downscaleImage(image.pixels, scaledSize));
+        }
+        if (downscale && previewCache != nullptr) {
+            previewCache->store(filePath, targetSize, image);
+        }
+        return image;
+    }
+    return DecodedImage();
+}
+
+ImageLoader::ImageLoader(const ImageLibrary *library, ShowOrder *order, int queueDepth, QThreadPool *pool, PreviewCache *previewCache, QObject *parent)
+: QObject(parent),
+  m_library(library),
+  m_queueDepth(std::max(1, queueDepth)),
+  m_order(order),
+  m_previewCache(previewCache),
+  m_pool(pool)
+{
+    m_order->enterPass(m_pass);
+}
+
+ImageLoader::~ImageLoader()
+{
+    // queued decodes can't be taken back from a shared pool, they return as soon as they start
+    std::unique_lock<std::mutex> lock(m_decodesMutex);
+    m_stopping = true;
+    m_decodesDone.wait(lock, [this]() { return m_decodesRunning == 0; });
+    m_order->leavePass(m_pass);
+}
+
+void ImageLoader::start()
+{
+    scheduleDecodes();
+}
+
+void ImageLoader::imagesAdded()
+{
+    m_failedInARow = 0;
+    scheduleDecodes();
+}
+
+void ImageLoader::setInterleave(int index, int count)
+{
+    m_interleaveCount = std::max(1, count);
+    m_interleaveIndex = std::clamp(index, 0, m_interleaveCount - 1);
+    m_position = m_interleaveIndex;
+}
+
+void ImageLoader::setTargetSize(const QSize &size)
+{
+    m_targetSize = size;
+}
+
+void ImageLoader::setProgressive(bool progressive)
+{
+    m_progressive = progressive;
+}
+
+void ImageLoader::setReadAhead(ReadAhead *readAhead)
+{
+    m_readAhead = readAhead;
+}
+
+bool ImageLoader::hasNext() const
+{
+    return !m_ready.empty();
+}
+
+bool ImageLoader::hasPreview() const
+{
+    return m_ready.empty() && !m_previewTaken && m_previews.count(m_deliverSequence) != 0;
+}
+
+ImagePreview ImageLoader::takePreview()
+{
+    if (!hasPreview()) {
+        return ImagePreview();
+    }
+    auto it = m_previews.find(m_deliverSequence);
+    ImagePreview preview = std::move(it->second);
+    m_previews.erase(it);
+    m_previewTaken = true;
+    return preview;
+}
+
+DecodedImage ImageLoader::takeNext()
+{
+    if (m_ready.empty()) {
+        return DecodedImage();
+    }
+    DecodedImage image = std::move(m_ready.front());
+    m_ready.pop_front();
+    scheduleDecodes();
+    return image;
+}
+
+quint32 ImageLoader::nextId()
+{
+    if (m_position >= m_order->passSize(m_pass) && m_pickedInPass) {
+        // entered first so the next pass isn't forgotten if this loader was the last one here
+        m_order->enterPass(m_pass + 1);
+        m_order->leavePass(m_pass);
+        ++m_pass;
+        m_position = m_interleaveIndex;
+        m_pickedInPass = false;
+    }
+    // with fewer images than interleaved loaders, some show the same ones
+    quint64 position = m_position % std::max<quint64>(1, m_order->passSize(m_pass));
+    m_position += m_interleaveCount;
+    m_pickedInPass = true;
+    return m_order->id(m_pass, position);
+}
+
+void ImageLoader::scheduleDecodes()
+{
+    if (m_library->availableCount() == 0) {
+        return;
+    }
+    // every image of the list failed in a row, don't spin on decoding them again
+    if (m_failedInARow >= m_library->availableCount()) {
+        return;
+    }
+
+    // images are picked from the order as many files ahead of the decodes as are read ahead
+    size_t inFlight = m_submitSequence - m_deliverSequence + m_ready.size();
+    size_t wanted = inFlight < size_t(m_queueDepth) ? size_t(m_queueDepth) - inFlight : 0;
+    if (m_readAhead != nullptr) {
+        wanted += m_readAhead->queueDepth();
+    }
+    size_t skipped = 0;
+    while (m_upcoming.size() < wanted) {
+        quint32 id = nextId();
+        if (!m_library->isAvailable(id)) {
+            // not checked by the scan yet or went away while the show runs
+            if (++skipped >= m_library->count()) {
+                break;
+            }
+            continue;
+        }
+        m_upcoming.push_back(m_library->path(id));
+        if (m_readAhead != nullptr) {
+            m_readAhead->request(m_upcoming.back());
+        }
+    }
+
+    while (m_submitSequence - m_deliverSequence + m_ready.size() < size_t(m_queueDepth) && !m_upcoming.empty()) {
+        QString filePath = std::move(m_upcoming.front());
+        m_upcoming.pop_front();
+
+        quint64 sequence = m_submitSequence++;
+        {
+            std::lock_guard<std::mutex> lock(m_decodesMutex);
+            ++m_decodesRunning;
+        }
+        m_pool->start([this, sequence, filePath, targetSize = m_targetSize, progressive = m_progressive]() {
+            {
+                std::lock_guard<std::mutex> lock(m_decodesMutex);
+                if (m_stopping) {
+                    --m_decodesRunning;
+                    m_decodesDone.notify_all();
+                    return;
+                }
+            }
+            TRACE_SCOPE("load image");
+            QElapsedTimer decodeTime;
+            decodeTime.start();
+            // cached previews are keyed on the path, mtime and size of the file, a hit needs
+            // neither the file opened nor its image size
+            DecodedImage image = m_previewCache != nullptr && targetSize.isValid() ? m_previewCache->load(filePath, targetSize) : DecodedImage();
+            if (!image.isNull()) {
+                if (m_readAhead != nullptr) {
+                    m_readAhead->drop(filePath);
+                }
+            } else {
+                // mapped once, the decoders and the preview read the mapping in place
+                FileData file(filePath, m_readAhead != nullptr ? m_readAhead->take(filePath) : QByteArray());
+                if (progressive) {
+                    TRACE_SCOPE("read exif preview");
+                    ImagePreview preview = readExifPreview(file, targetSize);
+                    if (!preview.isNull()) {
+                        QMetaObject::invokeMethod(this, [this, sequence, preview]() {
+                            onPreviewRead(sequence, preview);
+                        }, Qt::QueuedConnection);
+                    }
+                }
+                image = decodeImage(file, targetSize, m_previewCache);
+            }
+            double decodeMs = decodeTime.nsecsElapsed() / 1e6;
+            QMetaObject::invokeMethod(this, [this, sequence, filePath, image, decodeMs]() {
+                onImageDecoded(sequence, filePath, image, decodeMs);
+            }, Qt::QueuedConnection);
+            finishDecode();
+        });
+    }
+}
+
+// on the pool thread, the loader may be destroyed as soon as the lock is released
+void ImageLoader::finishDecode()
+{
+    std::lock_guard<std::mutex> lock(m_decodesMutex);
+    --m_decodesRunning;
+    m_decodesDone.notify_all();
+}
+
+void ImageLoader::onImageDecoded(quint64 sequence, const QString &filePath, const DecodedImage &image, double decodeMs)
+{
+    if (image.isNull()) {
+        std::cerr << "Could not load image " << filePath.toStdString() << std::endl;
+    } else {
+        m_decodeLatency.add(decodeMs);
+    }
+    m_finished.emplace(sequence, image);
+
+    // hand out images in list order even if decodes complete out of order
+    bool gotImage = false;
+    for (auto it = m_finished.begin(); it != m_finished.end() && it->first == m_deliverSequence; it = m_finished.erase(it)) {
+        if (it->second.isNull()) {
+            ++m_failedInARow;
+        } else if (m_previewTaken) {
+            // its preview is on screen already
+            m_failedInARow = 0;
+            emit fullImageReady(it->second);
+        } else {
+            m_failedInARow = 0;
+            m_ready.push_back(std::move(it->second));
+            gotImage = true;
+        }
+        m_previewTaken = false;
+        m_previews.erase(m_deliverSequence);
+        ++m_deliverSequence;
+    }
+
+    scheduleDecodes();
+
+    if (gotImage) {
+        emit imageReady();
+    }
+}
+
+void ImageLoader::onPreviewRead(quint64 sequence, const ImagePreview &preview)
+{
+    // useless once the image itself is decoded
+    if (sequence < m_deliverSequence || m_finished.count(sequence) != 0) {
+        return;
+    }
+    m_previews.emplace(sequence, preview);
+    if (hasPreview()) {
+        emit previewReady();
+    }
+}
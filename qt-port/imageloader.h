@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QObject>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include "decodedimage.h"
+#include "exifpreview.h"
+#include "latencystats.h"
+
+class PreviewCache;
+class ImageLibrary;
+class ShowOrder;
+class ReadAhead;
+
+// Decodes upcoming images of the show on a worker pool so the GUI thread
+// only picks up images that are already decoded. Several loaders, one per window,
+// can share the library, the pool, the cache and the read-ahead.
+class ImageLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    // the order and the pool must outlive the loader, only the decodes of this loader are
+    // waited for when it goes away
+    ImageLoader(const ImageLibrary *library, ShowOrder *order, int queueDepth, QThreadPool *pool, PreviewCache *previewCache = nullptr, QObject *parent = nullptr);
+    virtual ~ImageLoader();
+
+    void start();
+    // to be called when images became available in the library, after the order was told
+    void imagesAdded();
+    // loaders with the same order take turns in it: loader index of count shows the
+    // images at positions index, index + count, ... of each pass
+    void setInterleave(int index, int count);
+    // images larger than this are decoded straight to the size they are displayed at
+    void setTargetSize(const QSize &size);
+    // with progressive loading on, the embedded preview of a JPEG is read ahead of decoding
+    // it and can be shown while the next image is still being decoded
+    void setProgressive(bool progressive);
+    // the files coming after the ones being decoded are read ahead, queue depth of them
+    void setReadAhead(ReadAhead *readAhead);
+    bool hasNext() const;
+    DecodedImage takeNext();
+    // whether the preview of the next image is there while the image itself isn't yet
+    bool hasPreview() const;
+    // the image comes with fullImageReady() instead of takeNext()
+    ImagePreview takePreview();
+    // of the images decoded, from the file being opened to the decoded pixels, on a worker
+    const LatencyStats &decodeLatency() const { return m_decodeLatency; }
+
+signals:
+    void imageReady();
+    void previewReady();
+    // the full image of the preview taken last
+    void fullImageReady(const DecodedImage &image);
+
+private:
+    void scheduleDecodes();
+    quint32 nextId();
+    void onImageDecoded(quint64 sequence, const QString &filePath, const DecodedImage &image, double decodeMs);
+    void onPreviewRead(quint64 sequence, const ImagePreview &preview);
+    void finishDecode();
+
+    const ImageLibrary *m_library;
+    int m_queueDepth;
+    size_t m_failedInARow = 0;
+
+    ShowOrder *m_order;
+    quint64 m_pass = 0;
+    quint64 m_position = 0;                 // next position of this loader in the pass
+    bool m_pickedInPass = false;
+    int m_interleaveIndex = 0;
+    int m_interleaveCount = 1;
+    QSize m_targetSize;
+    PreviewCache *m_previewCache;
+
+    quint64 m_submitSequence = 0;           // sequence number of the next decode to submit
+    quint64 m_deliverSequence = 0;          // sequence number of the next decode to hand out
+    std::map<quint64, DecodedImage> m_finished; // decodes completed out of order, null image on failure
+    std::deque<DecodedImage> m_ready;
+
+    ReadAhead *m_readAhead = nullptr;
+    std::deque<QString> m_upcoming;         // picked from the order, and read ahead, but not submitted yet
+
+    bool m_progressive = false;
+    std::map<quint64, ImagePreview> m_previews; // by sequence number, of decodes not delivered yet
+    bool m_previewTaken = false;            // the image of m_deliverSequence goes to fullImageReady()
+    LatencyStats m_decodeLatency;
+
+    QThreadPool *m_pool;
+    std::mutex m_decodesMutex;
+    std::condition_variable m_decodesDone;
+    int m_decodesRunning = 0;               // submitted to the pool and not finished yet
+    bool m_stopping = false;                // decodes not started yet are skipped
+};
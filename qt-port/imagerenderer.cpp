@@ -0,0 +1,771 @@
+#include "imagerenderer.h"
+#include "trace.h"
+#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLPaintDevice>
+#include <QPainter>
+#include <QVector2D>
+#include <QVector4D>
+#include <QScreen>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static const float kBackgroundDarken = 0.6f;
+static const int kUploadPollInterval = 2;
+
+ImageRenderer::ImageRenderer(ImageView *view, QObject *parent)
+: QObject(parent),
+  m_view(view)
+{
+    m_uploadTimer = new QTimer(this);
+    m_uploadTimer->setInterval(kUploadPollInterval);
+    connect(m_uploadTimer, &QTimer::timeout, this, &ImageRenderer::checkUpload);
+    m_uploadPool.setMaxThreadCount(1);
+}
+
+ImageRenderer::~ImageRenderer()
+{
+    m_uploadPool.waitForDone();
+}
+
+void ImageRenderer::cleanup()
+{
+    // the pixel buffer must not be unmapped under a write
+    m_uploadPool.waitForDone();
+    if (m_shader == nullptr) {
+        return;
+    }
+    m_view->makeViewCurrent();
+    if (m_uploadFence != nullptr) {
+        glDeleteSync(m_uploadFence);
+        m_uploadFence = nullptr;
+    }
+    glDeleteBuffers(1, &m_uploadBuffer);
+    glDeleteFramebuffers(1, &m_paddingFbo);
+    glDeleteQueries(1, &m_frameQuery);
+    releaseImage(m_pendingImage);
+    releaseImage(m_image);
+    // a shared pool loses the idle textures of the other views too, any context of the
+    // share group can free them
+    m_texturePool->clear();
+    m_bgFbo.reset();
+    m_backFbo.reset();
+    m_vao.destroy();
+    m_vbo.destroy();
+    delete m_shader;
+    m_shader = nullptr;
+    m_view->doneViewCurrent();
+}
+
+// draws the whole view: the background, darkened, with the image blended over it
+static const char *vertexShaderSrc = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+
+out vec2 ScreenPos;
+
+void main() {
+    // unit square covering the viewport, from its top-left corner
+    gl_Position = vec4(aPos.x * 2.0 - 1.0, 1.0 - aPos.y * 2.0, 0.0, 1.0);
+    ScreenPos = aPos;
+}
+)";
+
+static const char *fragmentShaderSrc = R"(
+#version 330 core
+out vec4 FragColor;
+
+in vec2 ScreenPos;
+
+uniform sampler2D background;
+uniform sampler2D image;
+uniform sampler2D cbPlane;
+uniform sampler2D crPlane;
+uniform vec2 screenSize;
+uniform vec4 imageRect;
+uniform vec2 imageScale;
+uniform vec2 imageLimit;
+uniform vec2 chromaScale;
+uniform vec2 chromaLimit;
+uniform float darken;
+uniform float opacity;
+uniform int channels;
+uniform bool discardOutside;
+uniform bool blendOver;
+
+void main() {
+    vec2 imagePos = (ScreenPos * screenSize - imageRect.xy) / imageRect.zw;
+    // the texture may be larger than the image, keep the filter off the rest of it
+    vec4 textureColor = texture(image, min(imagePos * imageScale, imageLimit));
+    if (channels == 1) {
+        textureColor = textureColor.bgra;
+    } else if (channels == 2) {
+        textureColor = vec4(textureColor.rrr, 1.0);
+    } else if (channels == 3) {
+        // JFIF YCbCr, full range
+        vec2 chromaPos = min(imagePos * chromaScale, chromaLimit);
+        float y = textureColor.r;
+        float cb = texture(cbPlane, chromaPos).r - 0.5;
+        float cr = texture(crPlane, chromaPos).r - 0.5;
+        textureColor = vec4(y + 1.402 * cr, y - 0.344136 * cb - 0.714136 * cr, y + 1.772 * cb, 1.0);
+    }
+    bool inside = all(greaterThanEqual(imagePos, vec2(0.0))) && all(lessThan(imagePos, vec2(1.0)));
+    if (!inside && discardOutside) {
+        discard;
+    }
+    float alpha = inside ? textureColor.a * opacity : 0.0;
+    if (blendOver) {
+        // the target holds the darkened background already, GL blending does the rest
+        FragColor = vec4(textureColor.rgb, alpha);
+        return;
+    }
+
+    vec3 color = texture(background, vec2(ScreenPos.x, 1.0 - ScreenPos.y)).rgb * (1.0 - darken);
+    FragColor = vec4(mix(color, textureColor.rgb, alpha), 1.0);
+}
+)";
+
+// order of the channels in the texture, matches the fragment shader
+enum TextureChannels {
+    kChannelsRGBA = 0,
+    kChannelsBGRA = 1,
+    kChannelsGray = 2,
+    kChannelsYCbCr = 3  // in three single channel textures
+};
+
+// image formats uploaded as they are, without converting them first
+struct PixelLayout {
+    QImage::Format format;
+    int bytesPerPixel;
+    QOpenGLTexture::TextureFormat textureFormat;
+    QOpenGLTexture::PixelFormat pixelFormat;
+    int channels;
+};
+
+static const PixelLayout kPixelLayouts[] = {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // 0xAARRGGBB words are B, G, R, A bytes in memory
+    { QImage::Format_RGB32, 4, QOpenGLTexture::RGBA8_UNorm, QOpenGLTexture::RGBA, kChannelsBGRA },
+    { QImage::Format_ARGB32, 4, QOpenGLTexture::RGBA8_UNorm, QOpenGLTexture::RGBA, kChannelsBGRA },
+#endif
+    { QImage::Format_RGBA8888, 4, QOpenGLTexture::RGBA8_UNorm, QOpenGLTexture::RGBA, kChannelsRGBA },
+    { QImage::Format_RGBX8888, 4, QOpenGLTexture::RGBA8_UNorm, QOpenGLTexture::RGBA, kChannelsRGBA },
+    { QImage::Format_RGB888, 3, QOpenGLTexture::RGB8_UNorm, QOpenGLTexture::RGB, kChannelsRGBA },
+    { QImage::Format_Grayscale8, 1, QOpenGLTexture::R8_UNorm, QOpenGLTexture::Red, kChannelsGray },
+};
+
+static const PixelLayout &pixelLayoutFor(QImage::Format format)
+{
+    for (const auto &layout : kPixelLayouts) {
+        if (layout.format == format) {
+            return layout;
+        }
+    }
+    // anything else is converted, RGBA8888 comes right after the native formats
+    for (const auto &layout : kPixelLayouts) {
+        if (layout.format == QImage::Format_RGBA8888) {
+            return layout;
+        }
+    }
+    return kPixelLayouts[0];
+}
+
+static QOpenGLFramebufferObject *newBackground(int w, int h)
+{
+    QOpenGLFramebufferObjectFormat fmt;
+    fmt.setAttachment(QOpenGLFramebufferObject::NoAttachment);
+    fmt.setTextureTarget(GL_TEXTURE_2D);
+    return new QOpenGLFramebufferObject(w, h, fmt);
+}
+
+void ImageRenderer::initialize()
+{
+    initializeOpenGLFunctions();
+
+    m_shader = new QOpenGLShaderProgram();
+    m_shader->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSrc);
+    m_shader->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSrc);
+    m_shader->link();
+
+    m_vao.create();
+    m_vao.bind();
+
+    m_vbo.create();
+    m_vbo.bind();
+
+    float vertices[] = {
+        0.0f, 0.0f, // Top Left
+        1.0f, 0.0f, // Top Right
+        1.0f, 1.0f, // Bottom Right
+        0.0f, 1.0f  // Bottom Left
+    };
+    m_vbo.allocate(vertices, sizeof(vertices));
+
+    m_shader->enableAttributeArray(0);
+    m_shader->setAttributeBuffer(0, GL_FLOAT, 0, 2, 2 * sizeof(float));
+
+    m_vbo.release();
+    m_vao.release();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    glGenBuffers(1, &m_uploadBuffer);
+    glGenFramebuffers(1, &m_paddingFbo);
+    // tiles stay a power of two, which no pool bucket rounds up past the limit
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    m_maxTextureSize = 64;
+    while (m_maxTextureSize * 2 <= maxTextureSize) {
+        m_maxTextureSize *= 2;
+    }
+
+#ifdef GL_TIME_ELAPSED
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx->isOpenGLES() && (ctx->format().version() >= qMakePair(3, 3) || ctx->hasExtension("GL_ARB_timer_query"))) {
+        glGenQueries(1, &m_frameQuery);
+    }
+#endif
+
+    int w = m_view->viewSize().width();
+    int h = m_view->viewSize().height();
+    m_bgFbo.reset(newBackground(w, h));
+
+    m_bgFbo->bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+    m_bgFbo->release();
+
+    emit ready(w, h);
+}
+
+quint64 ImageRenderer::loadImage(const DecodedImage &img, int x, int y, int w, int h)
+{
+    if (m_shader == nullptr) {
+        return 0;
+    }
+
+    quint64 id = ++m_lastImageId;
+    if (m_uploading) {
+        m_queuedImage = img;
+        m_queuedRect.setRect(x, y, w, h);
+        m_queuedId = id;
+        m_queuedReplaces = false;
+        m_queuedReplaced = false;
+        return id;
+    }
+    beginUpload(img, QRect(x, y, w, h), id, false, false);
+    return id;
+}
+
+void ImageRenderer::replaceImage(quint64 id, const DecodedImage &img)
+{
+    // an image loaded later covers this one already, or is about to
+    if (m_shader == nullptr || id != m_lastImageId) {
+        return;
+    }
+
+    if (m_uploading) {
+        if (m_pendingId == id) {
+            // the preview is being uploaded, its replacement goes right after it
+            m_queuedRect = m_pendingRect;
+            m_queuedReplaces = true;
+            m_queuedReplaced = false;
+        } else {
+            // the preview is still queued and never shown, the image takes its slot and
+            // comes in as the slide itself, at the place the preview was given
+            m_queuedReplaces = false;
+            m_queuedReplaced = true;
+        }
+        m_queuedImage = img;
+        m_queuedId = id;
+        return;
+    }
+    beginUpload(img, m_imageRect, id, true, false);
+}
+
+void ImageRenderer::beginUpload(const DecodedImage &img, const QRect &rect, quint64 id, bool replaces, bool replaced)
+{
+    TRACE_SCOPE("begin upload");
+    m_uploading = true;
+    m_uploadElapsed.start();
+    m_pendingRect = rect;
+    m_pendingId = id;
+    m_pendingReplaces = replaces;
+    m_pendingReplaced = replaced;
+
+    // planes go as single channel images, one after the other in the pixel buffer
+    std::vector<QImage> sources;
+    if (img.isPlanar()) {
+        sources.assign(std::begin(img.planes), std::end(img.planes));
+    } else {
+        sources.push_back(img.pixels);
+    }
+    const PixelLayout &layout = pixelLayoutFor(sources[0].format());
+    bool convert = layout.format != sources[0].format();
+    int channels = img.isPlanar() ? kChannelsYCbCr : layout.channels;
+
+    std::vector<UploadPlane> planes;
+    GLsizeiptr bytes = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        UploadPlane plane;
+        plane.offset = bytes;
+        plane.size = sources[i].size();
+        plane.subsampling = i == 0 ? QSize(1, 1) : img.chromaSubsampling();
+        // rows padded to 4 bytes, the default unpack alignment
+        plane.stride = (qsizetype(plane.size.width()) * layout.bytesPerPixel + 3) & ~qsizetype(3);
+        bytes += GLsizeiptr(plane.stride) * plane.size.height();
+        planes.push_back(plane);
+    }
+
+    m_uploadStats.images += 1;
+    m_uploadStats.bytesUploaded += bytes;
+    if (convert) {
+        m_uploadStats.convertedImages += 1;
+        m_uploadStats.bytesConverted += bytes;
+    }
+
+    m_view->makeViewCurrent();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+    // new storage each time, the GPU may still be reading the previous one
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    auto pixels = static_cast<uchar*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_view->doneViewCurrent();
+
+    if (pixels == nullptr) {
+        std::cerr << "Could not map pixel buffer of " << bytes << " bytes" << std::endl;
+        m_uploading = false;
+        return;
+    }
+
+    QSize size = img.size;
+    m_uploadPool.start([this, sources, planes, convert, pixels, size, channels, &layout]() {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            QImage source = sources[i];
+            if (convert) {
+                TRACE_SCOPE("convertToFormat");
+                source = sources[i].convertToFormat(layout.format);
+            }
+            TRACE_SCOPE("copy to pixel buffer");
+            size_t rowBytes = size_t(source.width()) * layout.bytesPerPixel;
+            uchar *planePixels = pixels + planes[i].offset;
+            for (int y = 0; y < source.height(); ++y) {
+                std::memcpy(planePixels + y * planes[i].stride, source.constScanLine(y), rowBytes);
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, size, &layout, channels, planes]() { finishUpload(size, layout, channels, planes); }, Qt::QueuedConnection);
+    });
+}
+
+void ImageRenderer::finishUpload(const QSize &size, const PixelLayout &layout, int channels, const std::vector<UploadPlane> &planes)
+{
+    TRACE_SCOPE("create textures");
+    m_view->makeViewCurrent();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    releaseImage(m_pendingImage);
+    m_pendingImage.size = size;
+    m_pendingImage.channels = channels;
+    m_pendingImage.chromaSubsampling = planes.back().subsampling;
+
+    // sourced from the bound pixel buffer, the copies and the mipmaps are only queued;
+    // images larger than textures can be are split in tiles, each with its part of every plane
+    auto poolStats = m_texturePool->stats();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int y = 0; y < size.height(); y += m_maxTextureSize) {
+        for (int x = 0; x < size.width(); x += m_maxTextureSize) {
+            ImageTile tile;
+            tile.rect = QRect(x, y, std::min(m_maxTextureSize, size.width() - x), std::min(m_maxTextureSize, size.height() - y));
+            for (size_t i = 0; i < planes.size(); ++i) {
+                const UploadPlane &plane = planes[i];
+                int sx = plane.subsampling.width();
+                int sy = plane.subsampling.height();
+                QPoint topLeft(x / sx, y / sy);
+                QSize planeSize(std::min(plane.size.width(), (x + tile.rect.width() + sx - 1) / sx) - topLeft.x(),
+                                std::min(plane.size.height(), (y + tile.rect.height() + sy - 1) / sy) - topLeft.y());
+                if (i == 1) {
+                    tile.chromaSize = planeSize;
+                }
+
+                tile.textures[i] = m_texturePool->acquire(planeSize, layout.textureFormat, layout.pixelFormat);
+                tile.textures[i]->bind();
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, plane.size.width());
+                glPixelStorei(GL_UNPACK_SKIP_PIXELS, topLeft.x());
+                glPixelStorei(GL_UNPACK_SKIP_ROWS, topLeft.y());
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, planeSize.width(), planeSize.height(), GLenum(layout.pixelFormat), GL_UNSIGNED_BYTE,
+                                reinterpret_cast<const void*>(plane.offset));
+                padTexture(tile.textures[i].get(), planeSize);
+                {
+                    // queuing them, the GPU time shows in the frame times
+                    TRACE_SCOPE("generate mipmaps");
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                }
+                tile.textures[i]->release();
+            }
+            m_pendingImage.tiles.push_back(std::move(tile));
+        }
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_uploadStats.textureAllocations += (m_texturePool->stats().requests - poolStats.requests) - (m_texturePool->stats().hits - poolStats.hits);
+
+    m_uploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    m_view->doneViewCurrent();
+
+    m_uploadTimer->start();
+}
+
+// the image fills the top-left part of a pooled texture and the rest still holds earlier
+// images; its last column and row are stretched over the rest so that the mipmaps average
+// the edge of the image with itself instead of with those
+void ImageRenderer::padTexture(QOpenGLTexture *texture, const QSize &used)
+{
+    QSize size(texture->width(), texture->height());
+    if (used == size) {
+        return;
+    }
+    GLint boundFbo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &boundFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_paddingFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->textureId(), 0);
+    // the source and destination rects of each blit don't overlap
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        if (used.width() < size.width()) {
+            glBlitFramebuffer(used.width() - 1, 0, used.width(), used.height(),
+                              used.width(), 0, size.width(), used.height(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        if (used.height() < size.height()) {
+            glBlitFramebuffer(0, used.height() - 1, size.width(), used.height(),
+                              0, used.height(), size.width(), size.height(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(boundFbo));
+}
+
+void ImageRenderer::checkUpload()
+{
+    m_view->makeViewCurrent();
+    if (glClientWaitSync(m_uploadFence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        m_view->doneViewCurrent();
+        return;
+    }
+    m_uploadTimer->stop();
+    glDeleteSync(m_uploadFence);
+    m_uploadFence = nullptr;
+    m_uploadLatency.add(m_uploadElapsed.nsecsElapsed() / 1e6);
+
+    m_uploading = false;
+    if (m_pendingReplaces) {
+        m_imageRect = m_pendingRect;
+        if (!m_image.tiles.empty()) {
+            // still fading in, the fade goes on with the new textures
+            releaseImage(m_image);
+            m_image = std::move(m_pendingImage);
+        } else {
+            // already in the background, drawn over its own spot there
+            m_image = std::move(m_pendingImage);
+            bakeImage(0.0f);
+            releaseImage(m_image);
+            m_view->requestFrame();
+        }
+        m_view->doneViewCurrent();
+        emit imageReplaced(m_pendingId);
+    } else {
+        // an image still fading in is finished off into the background first
+        stopAnimation();
+        m_image = std::move(m_pendingImage);
+        m_imageRect = m_pendingRect;
+        m_view->doneViewCurrent();
+
+        startAnimation();
+        emit imageShown(m_pendingId, m_pendingReplaced);
+    }
+
+    if (!m_queuedImage.isNull()) {
+        DecodedImage next = std::move(m_queuedImage);
+        m_queuedImage = DecodedImage();
+        beginUpload(next, m_queuedRect, m_queuedId, m_queuedReplaces, m_queuedReplaced);
+    }
+}
+
+void ImageRenderer::composite(float darken, float opacity)
+{
+    if (!m_shader->isLinked()) {
+        return;
+    }
+
+    QSize viewSize = m_view->viewSize();
+    m_shader->bind();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_bgFbo->texture());
+    m_shader->setUniformValue("background", 0);
+    m_shader->setUniformValue("image", 1);
+    m_shader->setUniformValue("cbPlane", 2);
+    m_shader->setUniformValue("crPlane", 3);
+    m_shader->setUniformValue("screenSize", QVector2D(viewSize.width(), viewSize.height()));
+    m_shader->setUniformValue("darken", darken);
+    m_shader->setUniformValue("blendOver", m_painterFrames);
+    if (m_painterFrames) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    m_vao.bind();
+
+    const auto &tiles = m_image.tiles;
+    bool tiled = tiles.size() > 1;
+    if (tiles.size() != 1 && !m_painterFrames) {
+        // the background alone, tiles are then drawn over their own part of it
+        m_shader->setUniformValue("opacity", 0.0f);
+        m_shader->setUniformValue("discardOutside", false);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    }
+
+    if (!tiles.empty()) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        qreal pixelRatio = qreal(viewport[2]) / viewSize.width();
+        qreal scaleX = qreal(m_imageRect.width()) / m_image.size.width();
+        qreal scaleY = qreal(m_imageRect.height()) / m_image.size.height();
+
+        m_shader->setUniformValue("channels", m_image.channels);
+        m_shader->setUniformValue("opacity", opacity);
+        m_shader->setUniformValue("discardOutside", tiled);
+        if (tiled) {
+            glEnable(GL_SCISSOR_TEST);
+        }
+        for (const auto &tile : tiles) {
+            QRectF screenRect(m_imageRect.x() + tile.rect.x() * scaleX, m_imageRect.y() + tile.rect.y() * scaleY,
+                              tile.rect.width() * scaleX, tile.rect.height() * scaleY);
+            if (tiled) {
+                // with a pixel of margin, the shader drops what is outside of the tile
+                int left = int(std::floor(screenRect.left() * pixelRatio)) - 1;
+                int right = int(std::ceil(screenRect.right() * pixelRatio)) + 1;
+                int top = int(std::floor(screenRect.top() * pixelRatio)) - 1;
+                int bottom = int(std::ceil(screenRect.bottom() * pixelRatio)) + 1;
+                glScissor(left, viewport[3] - bottom, right - left, bottom - top);
+            }
+
+            for (int i = 0; i < 3 && tile.textures[i] != nullptr; ++i) {
+                tile.textures[i]->bind(1 + i);
+            }
+            QSizeF textureSize(tile.textures[0]->width(), tile.textures[0]->height());
+            m_shader->setUniformValue("imageRect", QVector4D(screenRect.x(), screenRect.y(), screenRect.width(), screenRect.height()));
+            m_shader->setUniformValue("imageScale", QVector2D(tile.rect.width() / textureSize.width(), tile.rect.height() / textureSize.height()));
+            m_shader->setUniformValue("imageLimit", QVector2D((tile.rect.width() - 0.5f) / textureSize.width(), (tile.rect.height() - 0.5f) / textureSize.height()));
+            if (tile.textures[1] != nullptr) {
+                QSizeF chromaTextureSize(tile.textures[1]->width(), tile.textures[1]->height());
+                QSizeF chromaSpan(qreal(tile.rect.width()) / m_image.chromaSubsampling.width(), qreal(tile.rect.height()) / m_image.chromaSubsampling.height());
+                m_shader->setUniformValue("chromaScale", QVector2D(chromaSpan.width() / chromaTextureSize.width(), chromaSpan.height() / chromaTextureSize.height()));
+                m_shader->setUniformValue("chromaLimit", QVector2D((tile.chromaSize.width() - 0.5f) / chromaTextureSize.width(), (tile.chromaSize.height() - 0.5f) / chromaTextureSize.height()));
+            }
+            glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+            for (int i = 0; i < 3 && tile.textures[i] != nullptr; ++i) {
+                tile.textures[i]->release(1 + i);
+            }
+        }
+        if (tiled) {
+            glDisable(GL_SCISSOR_TEST);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    m_vao.release();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_shader->release();
+    if (m_painterFrames) {
+        glDisable(GL_BLEND);
+    }
+}
+
+// the target is bound, darkened the way frames were before the compositor shader
+void ImageRenderer::painterDarken(const QSize &size, float darken)
+{
+    if (darken > 0.0f) {
+        QOpenGLPaintDevice device(size);
+        QPainter(&device).fillRect(QRect(QPoint(0, 0), size), QColor(0, 0, 0, static_cast<int>(darken * 255)));
+    }
+    glViewport(0, 0, size.width(), size.height());
+}
+
+void ImageRenderer::releaseImage(ImageTexture &image)
+{
+    for (auto &tile : image.tiles) {
+        for (auto &texture : tile.textures) {
+            if (texture != nullptr) {
+                m_texturePool->release(std::move(texture));
+            }
+        }
+    }
+    image.tiles.clear();
+}
+
+void ImageRenderer::bakeImage(float darken)
+{
+    TRACE_SCOPE("bake image");
+    if (m_painterFrames) {
+        m_bgFbo->bind();
+        painterDarken(m_bgFbo->size(), darken);
+        composite(darken, 1.0f);
+        m_bgFbo->release();
+        m_bytesFilled += quint64(m_bgFbo->width()) * m_bgFbo->height() * 4 * (darken > 0.0f ? 2 : 1);
+        return;
+    }
+    // the compositor can't sample the framebuffer it draws to, it goes to the other one
+    if (m_backFbo == nullptr || m_backFbo->size() != m_bgFbo->size()) {
+        m_backFbo.reset(newBackground(m_bgFbo->width(), m_bgFbo->height()));
+    }
+    m_backFbo->bind();
+    glViewport(0, 0, m_backFbo->width(), m_backFbo->height());
+    composite(darken, 1.0f);
+    m_backFbo->release();
+    m_bytesFilled += quint64(m_backFbo->width()) * m_backFbo->height() * 4;
+    std::swap(m_bgFbo, m_backFbo);
+}
+
+void ImageRenderer::resize(int w, int h)
+{
+    std::unique_ptr<QOpenGLFramebufferObject> newFbo(newBackground(w, h));
+
+    int prevHeight = m_bgFbo->height();
+    QRect srcRect(0, 0, std::min(w, m_bgFbo->width()), std::min(h, prevHeight));
+    if (srcRect.width() < w || srcRect.height() < h) {
+        newFbo->bind();
+        glClear(GL_COLOR_BUFFER_BIT);
+        newFbo->release();
+    }
+    QRect destRect = srcRect;
+    if (h > prevHeight) {
+        // we want content to stick to uper-left corner
+        destRect.translate(0, h - prevHeight);
+    } else if (h < prevHeight) {
+        srcRect.translate(0, prevHeight - h);
+    }
+
+    QOpenGLFramebufferObject::blitFramebuffer(newFbo.get(), destRect, m_bgFbo.get(), srcRect, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    m_bgFbo.reset(newFbo.release());
+    m_backFbo.reset();
+    m_view->requestFrame();
+
+    emit resized(w, h);
+}
+
+void ImageRenderer::startAnimation()
+{
+    m_animeElapsed.restart();
+    m_swapElapsed.invalidate();
+    m_animating = true;
+    m_view->requestFrame();
+}
+
+void ImageRenderer::stopAnimation()
+{
+    if (!m_image.tiles.empty()) {
+        bakeImage(kBackgroundDarken);
+        releaseImage(m_image);
+    }
+    m_animating = false;
+}
+
+void ImageRenderer::frameSwapped()
+{
+    if (!m_animating) {
+        // nothing moves, no more frames until the next image
+        return;
+    }
+
+    if (m_swapElapsed.isValid()) {
+        double interval = m_swapElapsed.nsecsElapsed() / 1e6;
+        m_frameInterval.add(interval);
+        QScreen *screen = m_view->viewScreen();
+        double refreshRate = screen != nullptr ? screen->refreshRate() : 0.0;
+        if (refreshRate > 0.0) {
+            m_frameJitter.add(std::abs(interval - 1000.0 / refreshRate));
+        }
+    }
+    m_swapElapsed.start();
+    m_view->requestFrame();
+}
+
+void ImageRenderer::beginFrameTiming()
+{
+#ifdef GL_TIME_ELAPSED
+    if (m_frameQuery == 0) {
+        return;
+    }
+    // the result of a frame comes a few frames later, frames in between are not timed
+    if (m_frameQueryPending) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(m_frameQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return;
+        }
+        GLuint nsecs = 0;
+        glGetQueryObjectuiv(m_frameQuery, GL_QUERY_RESULT, &nsecs);
+        m_frameGpuTime.add(nsecs / 1e6);
+        m_frameQueryPending = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_frameQuery);
+    m_frameQueryRunning = true;
+#endif
+}
+
+void ImageRenderer::endFrameTiming()
+{
+#ifdef GL_TIME_ELAPSED
+    if (m_frameQueryRunning) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_frameQueryRunning = false;
+        m_frameQueryPending = true;
+    }
+#endif
+}
+
+void ImageRenderer::paint()
+{
+    QElapsedTimer cpuTime;
+    cpuTime.start();
+    beginFrameTiming();
+
+    QSize framebufferSize = m_view->framebufferSize();
+    glViewport(0, 0, framebufferSize.width(), framebufferSize.height());
+    m_bytesFilled += quint64(framebufferSize.width()) * framebufferSize.height() * 4 * (1 + m_view->presentCopies());
+
+    if (m_painterFrames) {
+        // the background copied, darkened by a QPainter fill, then the image blended over it
+        QRect fboRect(0, 0, m_bgFbo->width(), m_bgFbo->height());
+        QOpenGLFramebufferObject::blitFramebuffer(nullptr, fboRect, m_bgFbo.get(), fboRect, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        if (!m_image.tiles.empty()) {
+            auto t = std::min(1.0f, float(m_animeElapsed.nsecsElapsed() / 1e9));
+            painterDarken(framebufferSize, t * kBackgroundDarken);
+            m_bytesFilled += quint64(framebufferSize.width()) * framebufferSize.height() * 4;
+            composite(t * kBackgroundDarken, t);
+            if (t >= 1.0f) {
+                stopAnimation();
+            }
+        }
+    } else if (!m_image.tiles.empty()) {
+        auto t = std::min(1.0f, float(m_animeElapsed.nsecsElapsed() / 1e9));
+        composite(t * kBackgroundDarken, t);
+        if (t >= 1.0f) {
+            stopAnimation();
+        }
+    } else {
+        composite(0.0f, 0.0f);
+    }
+
+    endFrameTiming();
+    m_frameCpuTime.add(cpuTime.nsecsElapsed() / 1e6);
+}
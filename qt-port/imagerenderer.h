@@ -0,0 +1,194 @@
+#pragma once
+
+#include <QObject>
+#include <QOpenGLExtraFunctions>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLBuffer>
+#include <QThreadPool>
+#include <memory>
+#include <vector>
+#include "latencystats.h"
+#include "texturepool.h"
+#include "decodedimage.h"
+
+class QOpenGLTexture;
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+class QScreen;
+class ImageRenderer;
+struct PixelLayout;
+
+// The widget or window an ImageRenderer draws into. It owns the renderer and forwards
+// its GL callbacks and swaps to it.
+class ImageView
+{
+public:
+    virtual ~ImageView() = default;
+
+    virtual ImageRenderer *renderer() = 0;
+    virtual void showView(const QRect &geometry, bool borderless) = 0;
+
+    virtual void makeViewCurrent() = 0;
+    virtual void doneViewCurrent() = 0;
+    virtual void requestFrame() = 0;
+    virtual QSize viewSize() const = 0;
+    virtual QSize framebufferSize() const = 0;
+    virtual QScreen *viewScreen() const = 0;
+    // full-frame copies made by Qt after each frame, to present it
+    virtual int presentCopies() const = 0;
+};
+
+// Draws the show: the background of the previous images, darkened, with the current
+// image fading in over it.
+class ImageRenderer : public QObject, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit ImageRenderer(ImageView *view, QObject *parent = nullptr);
+    virtual ~ImageRenderer();
+
+    // the image is converted and uploaded in the background, its fade starts once the
+    // texture is resident; returns the id the image is shown with
+    quint64 loadImage(const DecodedImage &img, int x, int y, int w, int h);
+    // puts img in place of the image loaded with id, a preview of it, without restarting
+    // its fade; dropped once a later image was loaded
+    void replaceImage(quint64 id, const DecodedImage &img);
+    void setTexturePoolBudget(qint64 bytes) { m_texturePool->setBudget(bytes); }
+    // draws frames the way it did before the compositor shader, darkening the background
+    // through a QPainter and blending the image over it, to compare their frame times
+    void setPainterFrames(bool painterFrames) { m_painterFrames = painterFrames; }
+    // renderers of views in one GL share group can pool their textures together; to be
+    // set before the view is shown
+    const std::shared_ptr<TexturePool> &texturePool() const { return m_texturePool; }
+    void setTexturePool(const std::shared_ptr<TexturePool> &pool) { m_texturePool = pool; }
+
+    // called by the view, with its context current for the GL ones
+    void initialize();
+    void resize(int w, int h);
+    void paint();
+    void frameSwapped();
+    void cleanup();
+
+    // from loadImage() to the texture being ready to draw
+    const LatencyStats &uploadLatency() const { return m_uploadLatency; }
+
+    struct UploadStats {
+        quint64 images = 0;
+        quint64 bytesUploaded = 0;
+        quint64 convertedImages = 0;    // not in a format the GPU takes as is
+        quint64 bytesConverted = 0;
+        quint64 textureAllocations = 0;
+    };
+    const UploadStats &uploadStats() const { return m_uploadStats; }
+
+    // time spent in paint() and, when the driver can tell, on the GPU for the frame
+    const LatencyStats &frameCpuTime() const { return m_frameCpuTime; }
+    const LatencyStats &frameGpuTime() const { return m_frameGpuTime; }
+    // time between the buffer swaps of a fade, and how far it is from the refresh period
+    const LatencyStats &frameInterval() const { return m_frameInterval; }
+    const LatencyStats &frameJitter() const { return m_frameJitter; }
+    // framebuffer bytes written by the frames so far, copies made to present them included
+    quint64 bytesFilled() const { return m_bytesFilled; }
+    const TexturePool::Stats &texturePoolStats() const { return m_texturePool->stats(); }
+
+signals:
+    void ready(int w, int h);
+    void resized(int w, int h);
+    // the first texture of the image is resident and starts fading in; replaced when it is
+    // the one of replaceImage(), which came before the image loaded first was uploaded
+    void imageShown(quint64 id, bool replaced);
+    // the texture of replaceImage() took the place of the previous one
+    void imageReplaced(quint64 id);
+    // emitted by the view
+    void closed();
+
+private:
+    // part of an image in pooled textures, filling their top-left part: one texture for
+    // pixels, three for the Y, Cb and Cr planes
+    struct ImageTile {
+        std::unique_ptr<QOpenGLTexture> textures[3];
+        QRect rect;         // in the image
+        QSize chromaSize;   // of the part of the chroma planes in textures[1] and [2]
+    };
+
+    // a single tile unless the image is larger than GL_MAX_TEXTURE_SIZE
+    struct ImageTexture {
+        std::vector<ImageTile> tiles;
+        QSize size;
+        int channels = 0;
+        QSize chromaSubsampling;
+    };
+
+    // where a plane of the image being uploaded is in the pixel buffer
+    struct UploadPlane {
+        qsizetype offset;
+        qsizetype stride;
+        QSize size;
+        QSize subsampling;  // image pixels per plane pixel
+    };
+
+    void composite(float darken, float opacity);
+    void painterDarken(const QSize &size, float darken);
+    void bakeImage(float darken);
+    void releaseImage(ImageTexture &image);
+    void startAnimation();
+    void stopAnimation();
+    void beginUpload(const DecodedImage &img, const QRect &rect, quint64 id, bool replaces, bool replaced);
+    void finishUpload(const QSize &size, const PixelLayout &layout, int channels, const std::vector<UploadPlane> &planes);
+    void padTexture(QOpenGLTexture *texture, const QSize &used);
+    void checkUpload();
+    void beginFrameTiming();
+    void endFrameTiming();
+
+    ImageView *m_view;
+
+    std::shared_ptr<TexturePool> m_texturePool = std::make_shared<TexturePool>();
+    GLint m_maxTextureSize = 4096;
+    ImageTexture m_image;
+    QRect m_imageRect;
+    quint64 m_lastImageId = 0;  // of the last image loaded
+    std::unique_ptr<QOpenGLFramebufferObject> m_bgFbo;
+    std::unique_ptr<QOpenGLFramebufferObject> m_backFbo;   // target of bakeImage(), then swapped
+    QOpenGLShaderProgram* m_shader = nullptr;
+    bool m_painterFrames = false;
+    bool m_animating = false;
+    QElapsedTimer m_animeElapsed;
+    QElapsedTimer m_swapElapsed;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_vbo;
+
+    // pixels are written into the mapped pixel buffer on m_uploadPool, then the GPU copies
+    // them into m_pendingImage and builds its mipmaps, a fence tells when it is done
+    bool m_uploading = false;
+    ImageTexture m_pendingImage;
+    QRect m_pendingRect;
+    quint64 m_pendingId = 0;
+    bool m_pendingReplaces = false;
+    bool m_pendingReplaced = false; // a new slide, with the image of replaceImage() already
+    DecodedImage m_queuedImage; // latest image loaded while uploading, goes next
+    QRect m_queuedRect;
+    quint64 m_queuedId = 0;
+    bool m_queuedReplaces = false;
+    bool m_queuedReplaced = false;
+    GLuint m_uploadBuffer = 0;
+    GLuint m_paddingFbo = 0;    // attaches pooled textures to fill their unused part
+    GLsync m_uploadFence = nullptr;
+    QTimer* m_uploadTimer;
+    QElapsedTimer m_uploadElapsed;
+    LatencyStats m_uploadLatency;
+    UploadStats m_uploadStats;
+
+    GLuint m_frameQuery = 0;
+    bool m_frameQueryRunning = false;
+    bool m_frameQueryPending = false;
+    LatencyStats m_frameCpuTime;
+    LatencyStats m_frameGpuTime;
+    LatencyStats m_frameInterval;
+    LatencyStats m_frameJitter;
+    quint64 m_bytesFilled = 0;
+
+    QThreadPool m_uploadPool;   // destroyed first, waits for a write in progress
+};
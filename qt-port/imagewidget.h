@@ -1,29 +1,28 @@
 #pragma once
 
 #include <QOpenGLWidget>
-#include <QOpenGLFunctions>
-#include <QTimer>
-#include <QElapsedTimer>
-#include <QOpenGLVertexArrayObject>
-#include <QOpenGLBuffer>
+#include "imagerenderer.h"
 
-class QOpenGLTexture;
-class QOpenGLFramebufferObject;
-class QOpenGLShaderProgram;
-
-class ImageWidget : public QOpenGLWidget, protected QOpenGLFunctions
+// Shows the renderer in a widget. Qt draws it into an offscreen framebuffer first and
+// copies that to the window.
+class ImageWidget : public QOpenGLWidget, public ImageView
 {
     Q_OBJECT
 
 public:
     explicit ImageWidget(QWidget* parent = nullptr, Qt::WindowFlags f = Qt::WindowFlags());
     virtual ~ImageWidget();
-    void loadImage(const QImage &img, int x, int y, int w, int h);
 
-signals:
-    void ready(int w, int h);
-    void closed();
-    void resized(int w, int h);
+    ImageRenderer *renderer() override { return &m_renderer; }
+    void showView(const QRect &geometry, bool borderless) override;
+
+    void makeViewCurrent() override { makeCurrent(); }
+    void doneViewCurrent() override { doneCurrent(); }
+    void requestFrame() override { update(); }
+    QSize viewSize() const override { return size(); }
+    QSize framebufferSize() const override { return size() * devicePixelRatio(); }
+    QScreen *viewScreen() const override { return screen(); }
+    int presentCopies() const override { return 1; }
 
 protected:
     void initializeGL() override;
@@ -32,16 +31,5 @@ protected:
     void closeEvent(QCloseEvent* event) override;
 
 private:
-    void drawTexturedQuad(float x, float y, float w, float h, float opacity);
-    void startAnimation();
-    void stopAnimation();
-
-    std::unique_ptr<QOpenGLTexture> m_image;
-    QRect m_imageRect;
-    std::unique_ptr<QOpenGLFramebufferObject> m_bgFbo;
-    QOpenGLShaderProgram* m_shader;
-    QTimer* m_animeTimer;
-    QElapsedTimer m_animeElapsed;
-    QOpenGLVertexArrayObject m_vao;
-    QOpenGLBuffer m_vbo;
+    ImageRenderer m_renderer;
 };
@@ -0,0 +1,46 @@
+#include "imagewindow.h"
+#include "trace.h"
+
+ImageWindow::ImageWindow(QWindow* parent)
+: QOpenGLWindow(QOpenGLWindow::NoPartialUpdate, parent),
+  m_renderer(this)
+{
+    // frames of a fade are paced by the buffer swaps, so by the display refresh
+    connect(this, &QOpenGLWindow::frameSwapped, &m_renderer, &ImageRenderer::frameSwapped);
+}
+
+ImageWindow::~ImageWindow()
+{
+    m_renderer.cleanup();
+}
+
+void ImageWindow::showView(const QRect &geometry, bool borderless)
+{
+    if (borderless) {
+        setFlags(flags() | Qt::FramelessWindowHint);
+    }
+    setGeometry(geometry);
+    show();
+}
+
+void ImageWindow::closeEvent(QCloseEvent* event)
+{
+    QOpenGLWindow::closeEvent(event);
+    emit m_renderer.closed();
+}
+
+void ImageWindow::initializeGL()
+{
+    m_renderer.initialize();
+}
+
+void ImageWindow::resizeGL(int w, int h)
+{
+    m_renderer.resize(w, h);
+}
+
+void ImageWindow::paintGL()
+{
+    TRACE_SCOPE("paintGL");
+    m_renderer.paint();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QOpenGLWindow>
+#include "imagerenderer.h"
+
+// Shows the renderer in a window of its own, drawing straight to the default framebuffer
+// of the window: no offscreen framebuffer and no extra copy of each frame as with
+// ImageWidget.
+class ImageWindow : public QOpenGLWindow, public ImageView
+{
+    Q_OBJECT
+
+public:
+    explicit ImageWindow(QWindow* parent = nullptr);
+    virtual ~ImageWindow();
+
+    ImageRenderer *renderer() override { return &m_renderer; }
+    void showView(const QRect &geometry, bool borderless) override;
+
+    void makeViewCurrent() override { makeCurrent(); }
+    void doneViewCurrent() override { doneCurrent(); }
+    void requestFrame() override { update(); }
+    QSize viewSize() const override { return size(); }
+    QSize framebufferSize() const override { return size() * devicePixelRatio(); }
+    QScreen *viewScreen() const override { return screen(); }
+    int presentCopies() const override { return 0; }
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+    void resizeGL(int w, int h) override;
+    void closeEvent(QCloseEvent* event) override;
+
+private:
+    ImageRenderer m_renderer;
+};
@@ -0,0 +1,99 @@
+#include "inotifywatcher.h"
+#include <QSocketNotifier>
+#include <QFile>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <iostream>
+
+static const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+
+InotifyWatcher::InotifyWatcher(const QRegularExpression &nameFilter, bool recursive, QObject *parent)
+: LibraryWatcher(nameFilter, recursive, parent),
+  m_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+    if (m_fd >= 0) {
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &InotifyWatcher::readEvents);
+    }
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    if (m_fd >= 0) {
+        delete m_notifier;
+        close(m_fd);
+    }
+}
+
+void InotifyWatcher::watchDirectory(const QString &dirPath)
+{
+    int wd = inotify_add_watch(m_fd, QFile::encodeName(dirPath).constData(), kWatchMask);
+    if (wd < 0) {
+        if (errno == ENOSPC && !m_warnedLimit) {
+            std::cerr << "Out of inotify watches, raise fs.inotify.max_user_watches to follow every directory" << std::endl;
+            m_warnedLimit = true;
+        }
+        return;
+    }
+    m_dirs.insert(wd, dirPath);
+}
+
+void InotifyWatcher::unwatchTree(const QString &dirPath)
+{
+    QString prefix = dirPath + '/';
+    for (auto it = m_dirs.begin(); it != m_dirs.end();) {
+        if (it.value() == dirPath || it.value().startsWith(prefix)) {
+            inotify_rm_watch(m_fd, it.key());
+            it = m_dirs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void InotifyWatcher::readEvents()
+{
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (char *p = buffer; p < buffer + length;) {
+            auto event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::cerr << "Too many file changes at once, some of them were missed" << std::endl;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                m_dirs.remove(event->wd);
+                continue;
+            }
+
+            auto dir = m_dirs.constFind(event->wd);
+            if (dir == m_dirs.constEnd() || event->len == 0) {
+                continue;
+            }
+            QString dirPath = dir.value();
+            QString name = QFile::decodeName(event->name);
+
+            if (event->mask & IN_ISDIR) {
+                QString subdirPath = dirPath + '/' + name;
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    queueDirectoryCreated(subdirPath);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    unwatchTree(subdirPath);
+                    queueDirectoryRemoved(subdirPath);
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                // files are picked up once written, not when created empty
+                queueFileAdded(dirPath, name);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                queueFileRemoved(dirPath, name);
+            }
+        }
+    }
+}
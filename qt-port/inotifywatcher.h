@@ -0,0 +1,26 @@
+#pragma once
+
+#include "librarywatcher.h"
+#include <QHash>
+
+class QSocketNotifier;
+
+// Linux backend of LibraryWatcher, one inotify watch per directory.
+class InotifyWatcher : public LibraryWatcher
+{
+public:
+    InotifyWatcher(const QRegularExpression &nameFilter, bool recursive, QObject *parent = nullptr);
+    virtual ~InotifyWatcher();
+
+    bool isValid() const { return m_fd >= 0; }
+    void watchDirectory(const QString &dirPath) override;
+
+private:
+    void readEvents();
+    void unwatchTree(const QString &dirPath);
+
+    int m_fd;
+    QSocketNotifier *m_notifier = nullptr;
+    QHash<int, QString> m_dirs;     // watch descriptor -> directory
+    bool m_warnedLimit = false;
+};
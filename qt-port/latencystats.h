@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Running statistics of a duration measured again and again. Count, mean and max
+// cover every sample, percentiles only the most recent ones so memory stays bounded
+// however long the show runs.
+class LatencyStats
+{
+public:
+    explicit LatencyStats(size_t window = 4096)
+    : m_window(window)
+    {
+    }
+
+    void add(double ms)
+    {
+        if (m_recent.size() < m_window) {
+            m_recent.push_back(float(ms));
+        } else {
+            m_recent[m_count % m_window] = float(ms);
+        }
+        ++m_count;
+        m_total += ms;
+        m_max = std::max(m_max, ms);
+    }
+
+    size_t count() const { return m_count; }
+    double mean() const { return m_count != 0 ? m_total / m_count : 0.0; }
+    double max() const { return m_max; }
+
+    // p in [0, 1]
+    double percentile(double p) const
+    {
+        if (m_recent.empty()) {
+            return 0.0;
+        }
+        std::vector<float> sorted(m_recent);
+        size_t rank = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+
+private:
+    size_t m_window;
+    std::vector<float> m_recent;
+    size_t m_count = 0;
+    double m_total = 0.0;
+    double m_max = 0.0;
+};
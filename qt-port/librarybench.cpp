@@ -0,0 +1,140 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include "imagelibrary.h"
+#include "fileindex.h"
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Memory held by the list of images of the show, for synthetic libraries of 10k, 100k and
+// 1M images in directories of 100: a QStringList of full paths, the way the show kept them
+// before ImageLibrary, against ImageLibrary filled by a scan and ImageLibrary reading the
+// file index of a previous run in place. Heap bytes are measured with glibc's allocator
+// statistics, elsewhere only ImageLibrary's own count is printed.
+
+static const int kFilesPerDirectory = 100;
+
+struct Library {
+    QStringList directories;
+    QStringList fileNames;     // the same in every directory
+};
+
+static Library makeLibrary(int fileCount)
+{
+    Library library;
+    for (int i = 0; i < kFilesPerDirectory; ++i) {
+        library.fileNames << QString("IMG_%1.jpg").arg(i, 4, 10, QChar('0'));
+    }
+    int directories = (fileCount + kFilesPerDirectory - 1) / kFilesPerDirectory;
+    for (int dir = 0; dir < directories; ++dir) {
+        library.directories << QString("/home/user/Pictures/%1/%2-%3 Trip to the mountains").arg(2000 + dir / 1000).arg(dir / 1000 % 12 + 1, 2, 10, QChar('0')).arg(dir % 1000, 3, 10, QChar('0'));
+    }
+    return library;
+}
+
+// -1 where the allocator doesn't tell
+static qint64 heapBytes()
+{
+#ifdef __GLIBC__
+    return qint64(mallinfo2().uordblks);
+#else
+    return -1;
+#endif
+}
+
+static qint64 measure(const std::function<void()> &build)
+{
+    qint64 before = heapBytes();
+    build();
+    qint64 after = heapBytes();
+    return before >= 0 ? after - before : -1;
+}
+
+static void print(const char *name, int fileCount, qint64 heap, qint64 other, const char *otherName)
+{
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1);
+    if (heap >= 0) {
+        std::cout << std::setw(10) << heap / 1048576.0 << " MiB heap" << std::setw(8) << double(heap) / fileCount << " B/image";
+    } else {
+        std::cout << std::setw(29) << "";
+    }
+    if (other >= 0) {
+        std::cout << std::setw(10) << other / 1048576.0 << " MiB " << otherName;
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineOption sizes(QStringList() << "sizes", "Numbers of images (default: 10000,100000,1000000).", "list", "10000,100000,1000000");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Image list memory");
+    parser.addHelpOption();
+    parser.addOption(sizes);
+    parser.process(app);
+
+    QTemporaryDir indexDir;
+    if (!indexDir.isValid()) {
+        std::cerr << "Could not create a temporary directory" << std::endl;
+        return 1;
+    }
+
+    for (const auto &size : parser.value(sizes).split(',', Qt::SkipEmptyParts)) {
+        int fileCount = std::max(1, size.trimmed().toInt());
+        Library source = makeLibrary(fileCount);
+        std::cout << fileCount << " images in " << source.directories.size() << " directories" << std::endl;
+
+        {
+            QStringList paths;
+            qint64 heap = measure([&paths, &source, fileCount]() {
+                for (const auto &dirPath : source.directories) {
+                    for (const auto &fileName : source.fileNames) {
+                        if (paths.size() < fileCount) {
+                            paths << dirPath + '/' + fileName;
+                        }
+                    }
+                }
+            });
+            print("QStringList", fileCount, heap, -1, "");
+        }
+
+        QString indexPath = indexDir.path() + "/library.idx";
+        {
+            ImageLibrary library;
+            qint64 heap = measure([&library, &source, fileCount]() {
+                int added = 0;
+                for (const auto &dirPath : source.directories) {
+                    QStringList fileNames = source.fileNames.mid(0, std::min(kFilesPerDirectory, fileCount - added));
+                    library.addScannedDirectory(dirPath, 0, fileNames);
+                    added += fileNames.size();
+                }
+            });
+            print("ImageLibrary", fileCount, heap, qint64(library.memoryUsage()), "counted");
+            if (!library.saveIndex(indexPath)) {
+                std::cerr << "Could not save the index" << std::endl;
+                return 1;
+            }
+        }
+
+        {
+            ImageLibrary library;
+            qint64 heap = measure([&library, &indexPath]() {
+                if (library.openIndex(indexPath)) {
+                    for (quint32 dir = 0; dir < library.index()->directoryCount(); ++dir) {
+                        library.addIndexedDirectory(dir);
+                    }
+                }
+            });
+            print("FileIndex", fileCount, heap, QFileInfo(indexPath).size(), "mapped");
+        }
+    }
+    return 0;
+}
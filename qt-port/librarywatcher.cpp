@@ -0,0 +1,108 @@
+#include "librarywatcher.h"
+#ifdef Q_OS_LINUX
+#include "inotifywatcher.h"
+#endif
+#include <utility>
+
+static const int kBatchInterval = 1000;    // milliseconds
+
+LibraryWatcher *LibraryWatcher::create(const QRegularExpression &nameFilter, bool recursive, QObject *parent)
+{
+#ifdef Q_OS_LINUX
+    auto watcher = new InotifyWatcher(nameFilter, recursive, parent);
+    if (watcher->isValid()) {
+        return watcher;
+    }
+    delete watcher;
+#endif
+    return nullptr;
+}
+
+LibraryWatcher::LibraryWatcher(const QRegularExpression &nameFilter, bool recursive, QObject *parent)
+: QObject(parent),
+  m_nameFilter(nameFilter),
+  m_recursive(recursive)
+{
+    m_batchTimer.setSingleShot(true);
+    m_batchTimer.setInterval(kBatchInterval);
+    connect(&m_batchTimer, &QTimer::timeout, this, &LibraryWatcher::flush);
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+}
+
+void LibraryWatcher::queueFileAdded(const QString &dirPath, const QString &fileName)
+{
+    if (!m_nameFilter.match(fileName).hasMatch()) {
+        return;
+    }
+    // a file replaced within the batch is still there, the library skips images it already has
+    auto removed = m_removed.find(dirPath);
+    if (removed != m_removed.end()) {
+        removed->remove(fileName);
+    }
+    m_added[dirPath].insert(fileName);
+    scheduleFlush();
+}
+
+void LibraryWatcher::queueFileRemoved(const QString &dirPath, const QString &fileName)
+{
+    if (!m_nameFilter.match(fileName).hasMatch()) {
+        return;
+    }
+    auto added = m_added.find(dirPath);
+    if (added != m_added.end()) {
+        added->remove(fileName);
+    }
+    m_removed[dirPath].insert(fileName);
+    scheduleFlush();
+}
+
+void LibraryWatcher::queueDirectoryCreated(const QString &dirPath)
+{
+    if (m_recursive) {
+        m_createdDirs << dirPath;
+        scheduleFlush();
+    }
+}
+
+void LibraryWatcher::queueDirectoryRemoved(const QString &dirPath)
+{
+    m_createdDirs.removeAll(dirPath);
+    m_removedDirs << dirPath;
+    scheduleFlush();
+}
+
+void LibraryWatcher::scheduleFlush()
+{
+    // not restarted on every event, a long copy still shows up batch after batch
+    if (!m_batchTimer.isActive()) {
+        m_batchTimer.start();
+    }
+}
+
+void LibraryWatcher::flush()
+{
+    auto removedDirs = std::exchange(m_removedDirs, {});
+    auto removed = std::exchange(m_removed, {});
+    auto createdDirs = std::exchange(m_createdDirs, {});
+    auto added = std::exchange(m_added, {});
+
+    for (const auto &dirPath : removedDirs) {
+        emit directoryRemoved(dirPath);
+    }
+    for (auto it = removed.cbegin(); it != removed.cend(); ++it) {
+        if (!it.value().isEmpty()) {
+            emit imagesRemoved(it.key(), it.value().values());
+        }
+    }
+    for (const auto &dirPath : createdDirs) {
+        emit directoryCreated(dirPath);
+    }
+    for (auto it = added.cbegin(); it != added.cend(); ++it) {
+        if (!it.value().isEmpty()) {
+            emit imagesAdded(it.key(), it.value().values());
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QObject>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+// Reports images appearing in or disappearing from watched directories while the
+// show runs. Changes are collected and reported in batches so a bulk copy turns into
+// a few updates instead of one per file.
+class LibraryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    // returns nullptr when no watching backend is available on this platform
+    static LibraryWatcher *create(const QRegularExpression &nameFilter, bool recursive, QObject *parent = nullptr);
+
+    virtual ~LibraryWatcher();
+    virtual void watchDirectory(const QString &dirPath) = 0;
+
+signals:
+    void imagesAdded(const QString &dirPath, const QStringList &fileNames);
+    void imagesRemoved(const QString &dirPath, const QStringList &fileNames);
+    void directoryCreated(const QString &dirPath);
+    void directoryRemoved(const QString &dirPath);
+
+protected:
+    LibraryWatcher(const QRegularExpression &nameFilter, bool recursive, QObject *parent);
+
+    void queueFileAdded(const QString &dirPath, const QString &fileName);
+    void queueFileRemoved(const QString &dirPath, const QString &fileName);
+    void queueDirectoryCreated(const QString &dirPath);
+    void queueDirectoryRemoved(const QString &dirPath);
+
+    QRegularExpression m_nameFilter;
+    bool m_recursive;
+
+private:
+    void scheduleFlush();
+    void flush();
+
+    QTimer m_batchTimer;
+    QHash<QString, QSet<QString>> m_added;
+    QHash<QString, QSet<QString>> m_removed;
+    QStringList m_createdDirs;
+    QStringList m_removedDirs;
+};
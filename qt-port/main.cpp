@@ -1,181 +1,252 @@
 #include <QApplication>
 #include <QCommandLineParser>
-#include <QDir>
 #include <QRegularExpression>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QScreen>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include "imagewidget.h"
+#include "imagewindow.h"
+#include "imageloader.h"
+#include "directoryscanner.h"
+#include "imagelibrary.h"
+#include "showorder.h"
+#include "librarywatcher.h"
+#include "imageutil.h"
+#include "previewcache.h"
+#include "readahead.h"
+#include "latencystats.h"
+#include "placementgrid.h"
+#include "trace.h"
 #include <iostream>
 #include <algorithm>
 #include <random>
+#include <memory>
+#include <map>
+#include <vector>
 #include <tuple>
 #include <cmath>
+#include <cstring>
+#include <functional>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
 
-struct ImageToLoad {
-    QString path;
-    int x;
-    int y;
-};
-
-static QStringList scanForFiles(const QDir& dir, const QStringList& filters, bool recursive) {
-    QStringList result;
-    for (auto& fn : dir.entryList(filters, QDir::Files | QDir::NoDotAndDotDot)) {
-        result << dir.absoluteFilePath(fn);
-    }
-    if (recursive) {
-        for (auto& subdir : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
-            result << scanForFiles(subdir.absoluteDir(), filters, true);
+class SlideShow : public QObject {
+public:
+    SlideShow(const ImageLibrary *library, ShowOrder *order, int interval, bool borderless, const QRect& geometry, bool glWindow, quint64 seed, int prefetchCount, QThreadPool *decodePool, PreviewCache *previewCache):
+        _loader(library, order, prefetchCount, decodePool, previewCache),
+        _interval(interval),
+        _borderless(borderless),
+        _geometry(geometry),
+        _placementSeed(seed)
+    {
+        if (glWindow) {
+            _view.reset(new ImageWindow());
+        } else {
+            _view.reset(new ImageWidget());
         }
+        _renderer = _view->renderer();
+        _loader.setTargetSize(geometry.size());
+        _loadTimer = new QTimer(this);
+        QObject::connect(_loadTimer, &QTimer::timeout, this, &SlideShow::loadNextImage);
+        QObject::connect(&_loader, &ImageLoader::imageReady, this, &SlideShow::onImageReady);
+        QObject::connect(&_loader, &ImageLoader::previewReady, this, &SlideShow::onImageReady);
+        QObject::connect(&_loader, &ImageLoader::fullImageReady, this, &SlideShow::onFullImageReady);
+        QObject::connect(_renderer, &ImageRenderer::imageShown, this, &SlideShow::onImageShown);
+        QObject::connect(_renderer, &ImageRenderer::imageReplaced, this, &SlideShow::onImageReplaced);
+        QObject::connect(_renderer, &ImageRenderer::ready, this, &SlideShow::onWidgetReady);
+        QObject::connect(_renderer, &ImageRenderer::closed, this, &SlideShow::onWidgetClosed);
+        QObject::connect(_renderer, &ImageRenderer::resized, this, &SlideShow::onWidgetResized);
     }
-    return result;
-}
-
-float peekaboo(std::random_device &randomizer, const std::vector<float> &pos, std::vector<float> &weight, float currentLength)
-{
-    float window = pos.back();
 
-    if (currentLength >= window) {
-        return 0.f;
+    void start() {
+        _loader.start();
+        _view->showView(_geometry, _borderless);
     }
 
-    float halfSize = currentLength / 2;
-
-    int startIndex = 0;
-    for (; startIndex < int(pos.size()); ++startIndex) {
-        if (pos[startIndex] >= halfSize) {
-            --startIndex;
-            break;
-        }
+    void imagesAdded() {
+        _loader.imagesAdded();
     }
 
-    int endIndex = pos.size() - 1;
-    for (; endIndex >= 0; --endIndex) {
-        if (window - pos[endIndex] >= halfSize) {
-            endIndex += 2;
-            break;
-        }
+    // shared by the windows of the process, their contexts are in one share group
+    void setTexturePool(const std::shared_ptr<TexturePool> &pool) {
+        _renderer->setTexturePool(pool);
     }
 
-    if (endIndex >= 0 && startIndex < endIndex) {
-        float center = static_cast<float>(std::piecewise_linear_distribution<>(pos.begin() + startIndex, pos.begin() + endIndex, weight.begin() + startIndex)(randomizer));
-        float left = std::max(0.0f, std::min(center - halfSize, window - currentLength));
-        float right = left + currentLength;
-        for (size_t i = 0; i < pos.size(); ++i) {
-            if (pos[i] >= left && pos[i] <= right) {
-                weight[i] = 1.f;
-            }
-            else {
-                weight[i] += 2.f;
-            }
-        }
-        return left;
+    // the windows of the process take turns in the same order, no two show the same image
+    void setInterleave(int index, int count) {
+        _loader.setInterleave(index, count);
+        // and place their images differently
+        _placementSeed = _placementSeed + 1 + quint64(index);
     }
-    return std::uniform_real_distribution<float>(0, window - currentLength)(randomizer);
-}
 
-template <typename T>
-inline int roundToNearest(T x)
-{
-    return static_cast<int>(std::floor(x + T(0.5)));
-}
-
-template <typename T>
-std::tuple<T, T> scaleToFit(T srcWidth, T srcHeight, T destWidth, T destHeight)
-{
-    if (srcWidth > T(0) && srcHeight > T(0))
-    {
-        T rw = destHeight * srcWidth / srcHeight;
-        if (rw <= destWidth)
-        {
-            return std::make_tuple(rw, destHeight);
-        }
-        else
-        {
-            return std::make_tuple(destWidth, srcHeight / srcWidth * destWidth);
-        }
+    void setReadAhead(ReadAhead *readAhead) {
+        _loader.setReadAhead(readAhead);
     }
-    return std::make_tuple(T(0), T(0));
-}
 
-inline std::tuple<int, int> scaleToFit(int srcWidth, int srcHeight, int destWidth, int destHeight)
-{
-    if (srcWidth > 0 && srcHeight > 0)
-    {
-        int rw = roundToNearest(destHeight * float(srcWidth) / srcHeight);
-        if (rw <= destWidth)
-        {
-            return std::make_tuple(rw, destHeight);
-        }
-        else
-        {
-            return std::make_tuple(destWidth, roundToNearest(srcHeight / (float)srcWidth * destWidth));
-        }
+    void setPainterFrames(bool painterFrames) {
+        _renderer->setPainterFrames(painterFrames);
     }
-    return std::make_tuple(0, 0);
-}
 
-
-class SlideShow : public QObject {
-public:
-    SlideShow(const QStringList &imageList, int interval, bool borderless, const QRect& geometry):
-        _images(imageList),
-        _widget(nullptr, borderless ? Qt::FramelessWindowHint : Qt::Widget),
-        _interval(interval)
-    {
-        _widget.setGeometry(geometry);
-        _loadTimer = new QTimer(this);
-        QObject::connect(_loadTimer, &QTimer::timeout, this, &SlideShow::loadNextImage);
-        QObject::connect(&_widget, &ImageWidget::ready, this, &SlideShow::onWidgetReady);
-        QObject::connect(&_widget, &ImageWidget::closed, this, &SlideShow::onWidgetClosed);
-        QObject::connect(&_widget, &ImageWidget::resized, this, &SlideShow::onWidgetResized);
+    // show the preview embedded in a JPEG while the image itself is still decoding
+    void setProgressive(bool progressive) {
+        _loader.setProgressive(progressive);
     }
 
-    void start() {
-        _widget.show();
+    // shows imageCount images back to back, each one loaded as soon as the previous one is
+    // on screen, then calls done
+    void setBenchmark(int imageCount, const std::function<void()> &done) {
+        _benchImages = imageCount;
+        _benchDone = done;
     }
 
+    // from a slide being due to its first texture fading in, and to its full image being on screen
+    const LatencyStats &firstPixelLatency() const { return _firstPixelLatency; }
+    const LatencyStats &fullImageLatency() const { return _fullImageLatency; }
+    const LatencyStats &decodeLatency() const { return _loader.decodeLatency(); }
+    const ImageRenderer *renderer() const { return _renderer; }
+    // full-frame copies made to present each frame, 1 through a widget, 0 drawing to a window
+    int presentCopies() const { return _view->presentCopies(); }
+    // images shown by the benchmark so far, and how long it took
+    int benchImagesShown() const { return _benchShown; }
+    double benchSeconds() const { return _benchSeconds; }
+
 private:
-    QStringList _images;
-    int _currentIndex = -1;
-    ImageWidget _widget;
+    struct SlideTiming {
+        QElapsedTimer due;
+        bool preview;
+    };
+
+    ImageLoader _loader;
+    bool _waitingForImage = false;
+    QElapsedTimer _slideDue;
+    quint64 _previewSlide = 0;
+    std::map<quint64, SlideTiming> _slideTimings;   // by renderer id, of slides not fully shown yet
+    LatencyStats _firstPixelLatency;
+    LatencyStats _fullImageLatency;
+    std::unique_ptr<ImageView> _view;
+    ImageRenderer *_renderer;
     int _interval;
+    bool _borderless;
+    QRect _geometry;
     QTimer* _loadTimer;
-    std::random_device _randomizer;
+    quint64 _placementSeed;
+    std::unique_ptr<PlacementGrid> _placement;
 
-    std::vector<float> _weightPosX;
-    std::vector<float> _weightValueX;
-    std::vector<float> _weightPosY;
-    std::vector<float> _weightValueY;
+    int _benchImages = 0;
+    int _benchShown = 0;
+    QElapsedTimer _benchElapsed;
+    double _benchSeconds = 0.0;
+    std::function<void()> _benchDone;
+
+    bool benchmarking() const {
+        return _benchShown < _benchImages;
+    }
 
     void loadNextImage() {
-        while (true) {
-            _currentIndex = (_currentIndex + 1) % _images.size();
-            const auto& filePath = _images[_currentIndex];
-            QImage image(filePath);
-            if (image.isNull()) {
-                std::cerr << "Could not load image " << filePath.toStdString() << std::endl;
-                if (_currentIndex + 1 >= _images.size()) {
-                    break;
-                }
-                continue;
+        TRACE_SCOPE("load next image");
+        if (!_waitingForImage) {
+            _slideDue.start();
+        }
+
+        DecodedImage image;
+        QSize fullSize;
+        bool preview = false;
+        if (_loader.hasNext()) {
+            image = _loader.takeNext();
+            fullSize = image.size;
+        } else if (_loader.hasPreview()) {
+            // placed where the full image goes, it replaces the preview when decoded
+            ImagePreview imagePreview = _loader.takePreview();
+            image = imagePreview.image;
+            fullSize = imagePreview.fullSize;
+            preview = true;
+        } else {
+            // decode is lagging behind, show the image as soon as it arrives
+            _waitingForImage = true;
+            return;
+        }
+        _waitingForImage = false;
+
+        auto imgWidth = fullSize.width();
+        auto imgHeight = fullSize.height();
+        auto maxWidth = _view->viewSize().width();
+        auto maxHeight = _view->viewSize().height();
+        if (imgWidth > maxWidth || imgHeight > maxHeight) {
+            std::tie(imgWidth, imgHeight) = scaleToFit(imgWidth, imgHeight, maxWidth, maxHeight); // m_renderTarget->GetSize();
+        }
+        int newX, newY;
+        {
+            TRACE_SCOPE("place image");
+            std::tie(newX, newY) = _placement->place(imgWidth, imgHeight);
+        }
+        quint64 slide = _renderer->loadImage(image, newX, newY, imgWidth, imgHeight);
+        _slideTimings[slide] = { _slideDue, preview };
+        if (preview) {
+            _previewSlide = slide;
+        }
+    }
+
+    void onFullImageReady(const DecodedImage &image) {
+        _renderer->replaceImage(_previewSlide, image);
+    }
+
+    void onImageShown(quint64 slide, bool replaced) {
+        // slides loaded before this one were dropped without being shown
+        _slideTimings.erase(_slideTimings.begin(), _slideTimings.lower_bound(slide));
+        auto it = _slideTimings.find(slide);
+        if (it != _slideTimings.end()) {
+            double ms = it->second.due.nsecsElapsed() / 1e6;
+            _firstPixelLatency.add(ms);
+            // the full image may have come before its preview was on screen, it is shown instead
+            if (!it->second.preview || replaced) {
+                _fullImageLatency.add(ms);
+                _slideTimings.erase(it);
             }
-            auto imgWidth = image.width();
-            auto imgHeight = image.height();
-            auto maxWidth = _widget.width();
-            auto maxHeight = _widget.height();
-            if (imgWidth > maxWidth || imgHeight > maxHeight) {
-                std::tie(imgWidth, imgHeight) = scaleToFit(imgWidth, imgHeight, maxWidth, maxHeight); // m_renderTarget->GetSize();
+        }
+
+        if (benchmarking()) {
+            if (++_benchShown < _benchImages) {
+                loadNextImage();
+            } else {
+                _benchSeconds = _benchElapsed.nsecsElapsed() / 1e9;
+                _benchDone();
             }
-            auto newX = peekaboo(_randomizer, _weightPosX, _weightValueX, imgWidth);
-            auto newY = peekaboo(_randomizer, _weightPosY, _weightValueY, imgHeight);
-            _widget.loadImage(image, roundToNearest(newX), roundToNearest(newY), imgWidth, imgHeight);
-            break;
         }
     }
 
-    void onWidgetReady(int w, int h) {
-        int numberOfRange = 20;
-        initWeightRange(_weightPosX, _weightValueX, numberOfRange, w);
-        initWeightRange(_weightPosY, _weightValueY, numberOfRange, h);
+    void onImageReplaced(quint64 slide) {
+        auto it = _slideTimings.find(slide);
+        if (it != _slideTimings.end()) {
+            _fullImageLatency.add(it->second.due.nsecsElapsed() / 1e6);
+            _slideTimings.erase(it);
+        }
+    }
 
+    void onImageReady() {
+        if (_waitingForImage && benchmarking()) {
+            loadNextImage();
+        } else if (_waitingForImage && _loadTimer->isActive()) {
+            loadNextImage();
+            _loadTimer->start(_interval);
+        }
+    }
+
+    void onWidgetReady(int w, int h) {
+        _placement = std::make_unique<PlacementGrid>(w, h, placementCellSize(w, h), _placementSeed);
+        _loader.setTargetSize(QSize(w, h));
+
+        if (benchmarking()) {
+            // no interval, the next image comes with the imageShown() of this one
+            _benchElapsed.start();
+            loadNextImage();
+            return;
+        }
         loadNextImage();
         _loadTimer->start(_interval);
     }
@@ -185,23 +256,15 @@ private:
     }
 
     void onWidgetResized(int w, int h) {
-        int numberOfRange = 20;
-        initWeightRange(_weightPosX, _weightValueX, numberOfRange, w);
-        initWeightRange(_weightPosY, _weightValueY, numberOfRange, h);
+        if (_placement) {
+            _placement->resize(w, h);
+        }
+        _loader.setTargetSize(QSize(w, h));
     }
 
-    static void initWeightRange(std::vector<float> &weightPos, std::vector<float> &weightValue, unsigned rangeCount, float length)
-    {
-        weightPos.reserve(rangeCount+1);
-        float rangeWidth = length / rangeCount;
-        float pos = 0;
-        while (weightPos.size() < rangeCount) {
-            weightPos.push_back(pos);
-            pos = pos + rangeWidth;
-        }
-        weightPos.push_back(length);
-        weightValue.resize(weightPos.size());
-        std::fill(weightValue.begin(), weightValue.end(), 1.0f);
+    // about 240 cells across the longer side whatever the screen, placing takes well under a millisecond
+    static int placementCellSize(int w, int h) {
+        return std::max(4, std::max(w, h) / 240);
     }
 };
 
@@ -235,17 +298,185 @@ static void parseGeometry(const QString &geometry, int *x, int *y, int *width, i
     }
 }
 
+static void printLatency(const char *what, const LatencyStats &stats) {
+    if (stats.count() == 0) {
+        return;
+    }
+    std::cout << what << ": p50 " << stats.percentile(0.5) << " ms, p99 " << stats.percentile(0.99) << " ms over " << stats.count() << " slides" << std::endl;
+}
+
+static void printReadAhead(const ReadAhead &readAhead) {
+    ReadAhead::Stats stats = readAhead.stats();
+    std::cout << "Read-ahead (" << (readAhead.usesIoUring() ? "io_uring" : "threads") << ", queue depth " << readAhead.queueDepth()
+              << ", " << readAhead.maxBytes() / (1024 * 1024) << " MiB): " << stats.filesRead << " files, "
+              << stats.bytesRead / (1024 * 1024) << " MiB read in " << stats.batches << " batches, "
+              << stats.hits << " ready, " << stats.waits << " waited for, " << stats.notStarted << " not started, " << stats.misses << " missed, " << stats.dropped << " dropped, " << stats.skipped << " skipped, peak "
+              << stats.peakFilesInFlight << " files and " << stats.peakBytes / (1024 * 1024) << " MiB in flight" << std::endl;
+}
+
+static QJsonObject latencyJson(const LatencyStats &stats) {
+    return QJsonObject {
+        { "count", qint64(stats.count()) },
+        { "mean", stats.mean() },
+        { "p50", stats.percentile(0.5) },
+        { "p90", stats.percentile(0.9) },
+        { "p99", stats.percentile(0.99) },
+        { "max", stats.max() },
+    };
+}
+
+// -1 where the system doesn't tell
+static qint64 peakRssBytes() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return qint64(usage.ru_maxrss);
+#else
+        return qint64(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return -1;
+}
+
+static void printBenchmark(const std::vector<std::unique_ptr<SlideShow>> &shows, const ReadAhead *readAhead) {
+    QJsonArray windows;
+    int images = 0;
+    double seconds = 0.0;
+    for (const auto &ss : shows) {
+        const ImageRenderer *renderer = ss->renderer();
+        const ImageRenderer::UploadStats &upload = renderer->uploadStats();
+        size_t frames = renderer->frameCpuTime().count();
+        double windowSeconds = ss->benchSeconds();
+        windows.append(QJsonObject {
+            { "images", ss->benchImagesShown() },
+            { "seconds", windowSeconds },
+            { "imagesPerSecond", windowSeconds > 0 ? ss->benchImagesShown() / windowSeconds : 0.0 },
+            { "decodeMs", latencyJson(ss->decodeLatency()) },
+            { "uploadMs", latencyJson(renderer->uploadLatency()) },
+            { "firstPixelMs", latencyJson(ss->firstPixelLatency()) },
+            { "fullImageMs", latencyJson(ss->fullImageLatency()) },
+            { "frameCpuMs", latencyJson(renderer->frameCpuTime()) },
+            { "frameGpuMs", latencyJson(renderer->frameGpuTime()) },
+            { "frameIntervalMs", latencyJson(renderer->frameInterval()) },
+            { "frameJitterMs", latencyJson(renderer->frameJitter()) },
+            { "upload", QJsonObject {
+                { "images", qint64(upload.images) },
+                { "bytesUploaded", qint64(upload.bytesUploaded) },
+                { "convertedImages", qint64(upload.convertedImages) },
+                { "bytesConverted", qint64(upload.bytesConverted) },
+                { "textureAllocations", qint64(upload.textureAllocations) },
+            } },
+            // what drawing to a window of its own saves over a widget shows here
+            { "fill", QJsonObject {
+                { "presentCopies", ss->presentCopies() },
+                { "frames", qint64(frames) },
+                { "bytesFilled", qint64(renderer->bytesFilled()) },
+                { "bytesPerFrame", frames != 0 ? double(renderer->bytesFilled()) / frames : 0.0 },
+            } },
+        });
+        images += ss->benchImagesShown();
+        seconds = std::max(seconds, windowSeconds);
+    }
+    qint64 peakRss = peakRssBytes();
+    QJsonObject result {
+        { "images", images },
+        { "seconds", seconds },
+        { "imagesPerSecond", seconds > 0 ? images / seconds : 0.0 },
+        { "peakRssBytes", peakRss >= 0 ? QJsonValue(peakRss) : QJsonValue() },
+        { "windows", windows },
+    };
+    // shared by the windows
+    if (!shows.empty()) {
+        const TexturePool::Stats &pool = shows.front()->renderer()->texturePoolStats();
+        result.insert("texturePool", QJsonObject {
+            { "requests", qint64(pool.requests) },
+            { "hits", qint64(pool.hits) },
+            { "hitRate", pool.requests != 0 ? double(pool.hits) / pool.requests : 0.0 },
+            { "residentBytes", pool.residentBytes },
+            { "idleBytes", pool.idleBytes },
+        });
+    }
+    if (readAhead != nullptr) {
+        ReadAhead::Stats stats = readAhead->stats();
+        result.insert("readAhead", QJsonObject {
+            { "ioUring", readAhead->usesIoUring() },
+            { "queueDepth", readAhead->queueDepth() },
+            { "requests", qint64(stats.requests) },
+            { "filesRead", qint64(stats.filesRead) },
+            { "bytesRead", qint64(stats.bytesRead) },
+            { "batches", qint64(stats.batches) },
+            { "hits", qint64(stats.hits) },
+            { "waits", qint64(stats.waits) },
+            { "notStarted", qint64(stats.notStarted) },
+            { "misses", qint64(stats.misses) },
+            { "dropped", qint64(stats.dropped) },
+            { "skipped", qint64(stats.skipped) },
+            { "peakBytes", stats.peakBytes },
+            { "peakFilesInFlight", stats.peakFilesInFlight },
+        });
+    }
+    std::cout << QJsonDocument(result).toJson().toStdString();
+}
+
+// one index per set of scanned directories and filters, next to the previews
+static QString fileIndexPath(const QString &cachePath, const QStringList &roots, const QStringList &filters, bool recursive) {
+    QStringList absoluteRoots;
+    for (const auto &root : roots) {
+        absoluteRoots << QFileInfo(root).absoluteFilePath();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(absoluteRoots.join('\n').toUtf8());
+    hash.addData(filters.join(',').toUtf8());
+    hash.addData(recursive ? "r" : "-");
+    return cachePath + "/index/" + QString::fromLatin1(hash.result().toHex()) + ".idx";
+}
+
 int main(int argc, char *argv[])
 {
+    // the benchmark needs no display, GL is rendered in software unless told otherwise
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--bench", 7) == 0) {
+            if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            }
+            if (!qEnvironmentVariableIsSet("LIBGL_ALWAYS_SOFTWARE")) {
+                qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+            }
+            break;
+        }
+    }
+    // the windows share their textures
+    QApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QApplication app(argc, argv);
     app.setApplicationVersion("1.0.0");
 
     QCommandLineOption borderless(QStringList() << "b" << "borderless", "Hide window title and border.");
     QCommandLineOption recursive(QStringList() << "r" << "recursive", "Scan directories recursively to look for images.");
-    QCommandLineOption shuffle(QStringList() << "s" << "shuffle", "Shuffle image list once before start the show.");
+    QCommandLineOption shuffle(QStringList() << "s" << "shuffle", "Show images in random order.");
     QCommandLineOption interval(QStringList() << "t" << "timeout", "Delay (seconds) before loading next image (default: 30).", "seconds", "30");
-    QCommandLineOption geometry(QStringList() << "g" << "geometry", "Window geometry (position is ignored on Wayland).", "spec", "1080x768+0+0");
+    QCommandLineOption geometry(QStringList() << "g" << "geometry", "Window geometry (position is ignored on Wayland), repeated for more windows.", "spec", "1080x768+0+0");
+    QCommandLineOption allScreens(QStringList() << "all-screens", "One window covering each screen instead of --geometry ones.");
     QCommandLineOption formatfilter(QStringList() << "f" << "format", "List of image formats to scan (default: jpg,jpeg,png,webp).", "extentions", "");
+    QCommandLineOption prefetch(QStringList() << "p" << "prefetch", "Number of upcoming images decoded ahead of time (default: 3).", "count", "3");
+    QCommandLineOption threads(QStringList() << "j" << "threads", "Number of background threads decoding images (default: 2).", "count", "2");
+    QCommandLineOption scanThreads(QStringList() << "scan-threads", "Number of background threads scanning directories (default: 4).", "count", "4");
+    QCommandLineOption cacheSize(QStringList() << "cache-size", "Disk space (MiB) for cached downscaled previews, 0 disables the cache (default: 2048).", "MiB", "2048");
+    QCommandLineOption cacheDir(QStringList() << "cache-dir", "Directory to keep cached previews and the file list of the previous run in, each in a directory of its own.", "path", "");
+    QCommandLineOption texturePool(QStringList() << "texture-pool", "Video memory (MiB) held by textures kept for reuse (default: 256).", "MiB", "256");
+    QCommandLineOption glWindow(QStringList() << "gl-window", "Draw straight to a window of its own rather than through a widget, saving a full-frame copy per frame.");
+    QCommandLineOption noWatch(QStringList() << "no-watch", "Don't follow images added to or removed from the directories while the show runs.");
+    QCommandLineOption seed(QStringList() << "seed", "Seed of the shuffled order, the same seed and images give the same show (default: random).", "number", "");
+    QCommandLineOption noIndex(QStringList() << "no-index", "Always scan every directory instead of reusing the file list of the previous run.");
+    QCommandLineOption readAheadCount(QStringList() << "read-ahead", "Number of files read ahead of the decodes, in one batch with io_uring, 0 disables it (default: 0).", "count", "0");
+    QCommandLineOption readAheadSize(QStringList() << "read-ahead-size", "Memory (MiB) held by files read ahead and not decoded yet (default: 256).", "MiB", "256");
+    QCommandLineOption bench(QStringList() << "bench", "Show count images in each window back to back, offscreen with software GL unless QT_QPA_PLATFORM and LIBGL_ALWAYS_SOFTWARE are set, then print throughput, latencies and peak memory as JSON and quit.", "count");
+    QCommandLineOption painterFrames(QStringList() << "painter-frames", "Darken the background through QPainter as earlier versions did instead of in the compositor shader, to compare frame times with --bench.");
+#ifdef ENABLE_TRACE
+    QCommandLineOption trace(QStringList() << "trace", "Record a timeline of the pipeline stages and write it as Chrome trace events to file, on exit and on SIGUSR1.", "file");
+#endif
+    QCommandLineOption noProgressive(QStringList() << "no-progressive", "Wait for images to be fully decoded instead of showing the preview embedded in JPEGs first.");
 
     QCommandLineParser parser;
     parser.setApplicationDescription("Simple Slideshow");
@@ -253,17 +484,44 @@ int main(int argc, char *argv[])
     parser.addVersionOption();
     parser.addOption(recursive);
     parser.addOption(shuffle);
+    parser.addOption(seed);
     parser.addOption(interval);
     parser.addOption(borderless);
     parser.addOption(geometry);
+    parser.addOption(allScreens);
+    parser.addOption(glWindow);
+    parser.addOption(texturePool);
     parser.addOption(formatfilter);
+    parser.addOption(prefetch);
+    parser.addOption(threads);
+    parser.addOption(readAheadCount);
+    parser.addOption(readAheadSize);
+    parser.addOption(scanThreads);
+    parser.addOption(cacheSize);
+    parser.addOption(cacheDir);
+    parser.addOption(noIndex);
+    parser.addOption(noProgressive);
+    parser.addOption(noWatch);
+    parser.addOption(bench);
+    parser.addOption(painterFrames);
+#ifdef ENABLE_TRACE
+    parser.addOption(trace);
+#endif
     parser.process(app);
 
+#ifdef ENABLE_TRACE
+    QString traceFile = parser.value(trace);
+    if (!traceFile.isEmpty()) {
+        startTrace();
+        writeTraceOnSignal(traceFile, &app);
+    }
+#endif
+
     QStringList args = parser.positionalArguments();
     QString extToScan = parser.value(formatfilter);
     QStringList filters;
     if (extToScan.isEmpty()) {
-        filters = { "*.jpg", ".jpeg", "*.png", "*.webp"};
+        filters = { "*.jpg", "*.jpeg", "*.png", "*.webp"};
     } else {
         filters = extToScan.split(',', Qt::SkipEmptyParts);
         for (auto& f : filters) {
@@ -271,33 +529,188 @@ int main(int argc, char *argv[])
         }
     }
 
-    QStringList imageList;
-    for (auto& path : args) {
-        imageList << scanForFiles(QDir(path), filters, parser.isSet(recursive));
+    int timeout = parser.value(interval).toInt();
+    if (timeout <= 0) {
+        timeout = 30;
     }
 
-    if (imageList.isEmpty()) {
-        std::cout << "No images found" << std::endl;
-        return 0;
+    // the windows share the scan, the decode threads, the caches and the textures, each
+    // one shows its own share of the images
+    QList<QRect> geometries;
+    if (parser.isSet(allScreens)) {
+        for (QScreen *screen : QGuiApplication::screens()) {
+            geometries.append(screen->geometry());
+        }
+    } else {
+        for (const auto &spec : parser.values(geometry)) {
+            int x = 0;
+            int y = 0;
+            int w = 1080;
+            int h = 768;
+            parseGeometry(spec, &x, &y, &w, &h);
+            geometries.append(QRect(x, y, w, h));
+        }
     }
 
-    if (parser.isSet(shuffle)) {
-        std::shuffle(imageList.begin(), imageList.end(), std::random_device());
+    int prefetchCount = parser.value(prefetch).toInt();
+    if (prefetchCount <= 0) {
+        prefetchCount = 3;
     }
 
-    int timeout = parser.value(interval).toInt();
-    if (timeout <= 0) {
-        timeout = 30;
+    int decodeThreads = parser.value(threads).toInt();
+    if (decodeThreads <= 0) {
+        decodeThreads = 2;
+    }
+
+    int scanThreadCount = parser.value(scanThreads).toInt();
+    if (scanThreadCount <= 0) {
+        scanThreadCount = 4;
+    }
+
+    bool seedIsSet = false;
+    quint64 shuffleSeed = parser.value(seed).toULongLong(&seedIsSet);
+    if (!seedIsSet) {
+        shuffleSeed = (quint64(std::random_device()()) << 32) | std::random_device()();
+    }
+
+    // previews and the index get directories of their own, the given one may hold anything
+    QString cachePath = parser.value(cacheDir);
+    if (cachePath.isEmpty()) {
+        cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    }
+    std::unique_ptr<PreviewCache> previewCache;
+    qint64 cacheMiB = parser.value(cacheSize).toLongLong();
+    if (cacheMiB > 0) {
+        previewCache.reset(new PreviewCache(cachePath + "/previews", cacheMiB * 1024 * 1024));
     }
 
-    int x = 0;
-    int y = 0;
-    int w = 1080;
-    int h = 768;
-    parseGeometry(parser.value(geometry), &x, &y, &w, &h);
+    std::unique_ptr<ReadAhead> readAhead;
+    int readAheadFiles = parser.value(readAheadCount).toInt();
+    if (readAheadFiles > 0) {
+        qint64 readAheadMiB = std::max<qint64>(1, parser.value(readAheadSize).toLongLong());
+        readAhead.reset(new ReadAhead(readAheadFiles, readAheadMiB * 1024 * 1024));
+    }
 
-    SlideShow ss(imageList, timeout * 1000, parser.isSet(borderless), QRect(x, y, w, h));
-    ss.start();
+    ImageLibrary library;
+    QString indexPath;
+    if (!parser.isSet(noIndex)) {
+        indexPath = fileIndexPath(cachePath, args, filters, parser.isSet(recursive));
+        library.openIndex(indexPath);
+    }
+
+    QThreadPool decodePool;
+    decodePool.setMaxThreadCount(decodeThreads);
+    qint64 texturePoolMiB = parser.value(texturePool).toLongLong();
+    auto sharedTexturePool = std::make_shared<TexturePool>(std::max<qint64>(0, texturePoolMiB) * 1024 * 1024);
+
+    // the benchmark measures full images, back to back they would mostly be replaced by previews
+    int benchImages = parser.isSet(bench) ? std::max(1, parser.value(bench).toInt()) : 0;
+    bool progressive = !parser.isSet(noProgressive) && benchImages == 0;
+
+    ShowOrder order(&library, parser.isSet(shuffle), shuffleSeed);
+    std::vector<std::unique_ptr<SlideShow>> shows;
+    for (const QRect &windowGeometry : geometries) {
+        auto ss = std::make_unique<SlideShow>(&library, &order, timeout * 1000, parser.isSet(borderless), windowGeometry, parser.isSet(glWindow), shuffleSeed, prefetchCount, &decodePool, previewCache.get());
+        ss->setTexturePool(sharedTexturePool);
+        ss->setInterleave(int(shows.size()), int(geometries.size()));
+        ss->setProgressive(progressive);
+        ss->setPainterFrames(parser.isSet(painterFrames));
+        ss->setReadAhead(readAhead.get());
+        shows.push_back(std::move(ss));
+    }
+    int benchRunning = int(shows.size());
+    if (benchImages > 0) {
+        for (const auto &ss : shows) {
+            ss->setBenchmark(benchImages, [&app, &benchRunning]() {
+                if (--benchRunning == 0) {
+                    app.quit();
+                }
+            });
+        }
+    }
+    auto imagesAdded = [&order, &shows]() {
+        order.imagesAdded();
+        for (const auto &ss : shows) {
+            ss->imagesAdded();
+        }
+    };
 
-    return app.exec();
+    std::unique_ptr<LibraryWatcher> watcher;
+    if (!parser.isSet(noWatch)) {
+        watcher.reset(LibraryWatcher::create(DirectoryScanner::nameFilterExpression(filters), parser.isSet(recursive)));
+    }
+
+    // images are fed to the show while the scan goes on, the first one shows up as soon as it is found
+    DirectoryScanner scanner(filters, parser.isSet(recursive), scanThreadCount, library.index());
+    QObject::connect(&scanner, &DirectoryScanner::directoryScanned, &app, [&imagesAdded, &library, &watcher](const QString &dirPath, qint64 mtime, const QStringList &fileNames) {
+        library.addScannedDirectory(dirPath, mtime, fileNames);
+        imagesAdded();
+        if (watcher) {
+            watcher->watchDirectory(dirPath);
+        }
+    });
+    QObject::connect(&scanner, &DirectoryScanner::directoryUnchanged, &app, [&imagesAdded, &library, &watcher](quint32 indexedDir) {
+        library.addIndexedDirectory(indexedDir);
+        imagesAdded();
+        if (watcher) {
+            watcher->watchDirectory(library.index()->directoryPath(indexedDir));
+        }
+    });
+
+    if (watcher) {
+        QObject::connect(watcher.get(), &LibraryWatcher::imagesAdded, &app, [&imagesAdded, &library](const QString &dirPath, const QStringList &fileNames) {
+            library.addFiles(dirPath, fileNames);
+            imagesAdded();
+        });
+        QObject::connect(watcher.get(), &LibraryWatcher::imagesRemoved, &app, [&library](const QString &dirPath, const QStringList &fileNames) {
+            library.removeFiles(dirPath, fileNames);
+        });
+        QObject::connect(watcher.get(), &LibraryWatcher::directoryCreated, &app, [&scanner](const QString &dirPath) {
+            scanner.scan(QStringList() << dirPath);
+        });
+        QObject::connect(watcher.get(), &LibraryWatcher::directoryRemoved, &app, [&library](const QString &dirPath) {
+            library.removeDirectoryTree(dirPath);
+        });
+    }
+    // the scans of directories created later finish too, they change nothing the next run needs
+    QObject::connect(&scanner, &DirectoryScanner::finished, &app, [&app, &library, &indexPath, initialScan = true]() mutable {
+        if (!initialScan) {
+            return;
+        }
+        initialScan = false;
+        if (!indexPath.isEmpty()) {
+            library.saveIndex(indexPath);
+        }
+        if (library.availableCount() == 0) {
+            std::cout << "No images found" << std::endl;
+            app.exit(0);
+        }
+    });
+
+    for (const auto &ss : shows) {
+        ss->start();
+    }
+    scanner.scan(args);
+
+    int result = app.exec();
+#ifdef ENABLE_TRACE
+    if (!traceFile.isEmpty()) {
+        writeTrace(traceFile);
+    }
+#endif
+
+    if (benchImages > 0) {
+        printBenchmark(shows, readAhead.get());
+        return result;
+    }
+    for (size_t i = 0; i < shows.size(); ++i) {
+        std::string window = shows.size() > 1 ? ", window " + std::to_string(i + 1) : std::string();
+        std::string firstPixel = parser.isSet(noProgressive) ? "Time to first pixel" : "Time to first pixel, previews first";
+        printLatency((firstPixel + window).c_str(), shows[i]->firstPixelLatency());
+        printLatency(("Time to full image" + window).c_str(), shows[i]->fullImageLatency());
+    }
+    if (readAhead) {
+        printReadAhead(*readAhead);
+    }
+    return result;
 }
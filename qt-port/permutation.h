@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+// Pseudo-random permutation of [0, size) computed on the fly: a keyed 4-round Feistel
+// network over the smallest power-of-4 domain holding size, with cycle walking to
+// stay inside [0, size). O(1) memory, the same seed always gives the same order.
+class RandomPermutation
+{
+public:
+    RandomPermutation() = default;
+
+    RandomPermutation(uint64_t size, uint64_t seed)
+    : m_size(size)
+    {
+        while ((uint64_t(1) << (2 * m_halfBits)) < size) {
+            ++m_halfBits;
+        }
+        m_halfMask = (uint64_t(1) << m_halfBits) - 1;
+        for (auto &key : m_keys) {
+            key = splitMix(seed);
+        }
+    }
+
+    uint64_t size() const { return m_size; }
+
+    // index must be lower than size()
+    uint64_t operator()(uint64_t index) const
+    {
+        uint64_t x = index;
+        do {
+            x = encrypt(x);
+        } while (x >= m_size);
+        return x;
+    }
+
+private:
+    static uint64_t splitMix(uint64_t &state)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t round(uint64_t half, uint64_t key) const
+    {
+        uint64_t z = (half ^ key) * 0xff51afd7ed558ccdULL;
+        z ^= z >> 33;
+        z *= 0xc4ceb9fe1a85ec53ULL;
+        z ^= z >> 33;
+        return z & m_halfMask;
+    }
+
+    uint64_t encrypt(uint64_t x) const
+    {
+        uint64_t left = x >> m_halfBits;
+        uint64_t right = x & m_halfMask;
+        for (uint64_t key : m_keys) {
+            uint64_t next = left ^ round(right, key);
+            left = right;
+            right = next;
+        }
+        return (left << m_halfBits) | right;
+    }
+
+    uint64_t m_size = 0;
+    unsigned m_halfBits = 0;
+    uint64_t m_halfMask = 0;
+    uint64_t m_keys[4] = {};
+};
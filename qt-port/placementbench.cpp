@@ -0,0 +1,81 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include "placementgrid.h"
+#include "imageutil.h"
+#include "latencystats.h"
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+
+// Time taken to place an image with PlacementGrid, from a 1080p screen to an 8K one and
+// from coarse cells to fine ones. Images are photos of the usual aspect ratios scaled to
+// fit the screen as the show does, a third of them smaller than the screen.
+
+struct Screen {
+    const char *name;
+    int width;
+    int height;
+};
+
+static std::vector<std::pair<int, int>> imageSizes(const Screen &screen, int count, uint64_t seed)
+{
+    static const std::pair<int, int> photos[] = { { 6000, 4000 }, { 4000, 6000 }, { 4032, 3024 }, { 3840, 2160 }, { 3000, 3000 }, { 1600, 1200 }, { 800, 600 } };
+    std::mt19937_64 random(seed);
+    std::vector<std::pair<int, int>> sizes;
+    for (int i = 0; i < count; ++i) {
+        auto [w, h] = photos[random() % std::size(photos)];
+        if (random() % 3 == 0) {
+            w = w * screen.height / 4000;
+            h = h * screen.height / 4000;
+        }
+        if (w > screen.width || h > screen.height) {
+            std::tie(w, h) = scaleToFit(w, h, screen.width, screen.height);
+        }
+        sizes.emplace_back(std::max(1, w), std::max(1, h));
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineOption count(QStringList() << "count", "Images placed per screen and cell size (default: 1000).", "count", "1000");
+    QCommandLineOption seed(QStringList() << "seed", "Seed of the image sizes and of the grids (default: 1).", "number", "1");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Placement grid speed");
+    parser.addHelpOption();
+    parser.addOption(count);
+    parser.addOption(seed);
+    parser.process(app);
+
+    int imageCount = std::max(1, parser.value(count).toInt());
+    uint64_t gridSeed = parser.value(seed).toULongLong();
+
+    static const Screen screens[] = { { "1080p", 1920, 1080 }, { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+    for (const auto &screen : screens) {
+        std::vector<std::pair<int, int>> sizes = imageSizes(screen, imageCount, gridSeed);
+        for (int cellSize : { 64, 32, 16, 8, 4 }) {
+            PlacementGrid grid(screen.width, screen.height, cellSize, gridSeed);
+            PlacementGrid replay(screen.width, screen.height, cellSize, gridSeed);
+            LatencyStats placeUs(sizes.size());
+            bool deterministic = true;
+            for (const auto &[w, h] : sizes) {
+                QElapsedTimer timer;
+                timer.start();
+                std::pair<int, int> position = grid.place(w, h);
+                placeUs.add(timer.nsecsElapsed() / 1e3);
+                deterministic = deterministic && replay.place(w, h) == position;
+            }
+            std::cout << std::left << std::setw(6) << screen.name << std::right << std::setw(4) << cellSize << " px cells"
+                      << std::setw(5) << grid.columns() << "x" << std::left << std::setw(5) << grid.rows() << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(10) << placeUs.percentile(0.5) << " us p50"
+                      << std::setw(10) << placeUs.percentile(0.99) << " us p99"
+                      << std::setw(10) << placeUs.max() << " us max"
+                      << (deterministic ? "" : "  NOT DETERMINISTIC") << std::endl;
+        }
+    }
+    return 0;
+}
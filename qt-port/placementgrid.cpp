@@ -0,0 +1,99 @@
+#include "placementgrid.h"
+#include <algorithm>
+#include <cmath>
+
+PlacementGrid::PlacementGrid(int width, int height, int cellSize, uint64_t seed)
+: m_cellSize(std::max(1, cellSize)),
+  m_random(seed)
+{
+    resize(width, height);
+}
+
+void PlacementGrid::resize(int width, int height)
+{
+    m_width = std::max(1, width);
+    m_height = std::max(1, height);
+    m_columns = (m_width + m_cellSize - 1) / m_cellSize;
+    m_rows = (m_height + m_cellSize - 1) / m_cellSize;
+    m_slide = 0;
+    m_covered.assign(size_t(m_columns) * m_rows, 0);
+    buildSums();
+}
+
+std::pair<int, int> PlacementGrid::place(int w, int h)
+{
+    w = std::clamp(w, 1, m_width);
+    h = std::clamp(h, 1, m_height);
+    int cellsX = (w + m_cellSize - 1) / m_cellSize;
+    int cellsY = (h + m_cellSize - 1) / m_cellSize;
+    int positionsX = m_columns - cellsX + 1;
+    int positionsY = m_rows - cellsY + 1;
+
+    // all candidates have the same area, the least covered sum is the stalest
+    uint64_t area = uint64_t(cellsX) * cellsY;
+    uint64_t least = UINT64_MAX;
+    for (int y = 0; y < positionsY; ++y) {
+        for (int x = 0; x < positionsX; ++x) {
+            least = std::min(least, coveredSum(x, y, x + cellsX, y + cellsY));
+        }
+    }
+    // staleness counted in slides since each cell was covered
+    uint64_t stalest = area * m_slide - least;
+    uint64_t threshold = stalest - uint64_t(stalest * kTolerance);
+    uint64_t highestSum = area * m_slide - threshold;
+
+    // uniform among the ones close enough, in one pass
+    int pickX = 0;
+    int pickY = 0;
+    uint64_t seen = 0;
+    for (int y = 0; y < positionsY; ++y) {
+        for (int x = 0; x < positionsX; ++x) {
+            if (coveredSum(x, y, x + cellsX, y + cellsY) <= highestSum && m_random() % ++seen == 0) {
+                pickX = x;
+                pickY = y;
+            }
+        }
+    }
+
+    // anywhere within the cell, images don't line up on the grid
+    std::uniform_int_distribution<int> offset(0, m_cellSize - 1);
+    int left = std::min(pickX * m_cellSize + offset(m_random), m_width - w);
+    int top = std::min(pickY * m_cellSize + offset(m_random), m_height - h);
+    cover(left, top, w, h);
+    return std::make_pair(left, top);
+}
+
+// the cells whose center the image covers
+void PlacementGrid::cover(int x, int y, int w, int h)
+{
+    auto cellRange = [this](int begin, int length, int count) {
+        double half = m_cellSize * 0.5;
+        int first = std::clamp(int(std::ceil((begin - half) / m_cellSize)), 0, count - 1);
+        int last = std::clamp(int(std::ceil((begin + length - half) / m_cellSize)), first + 1, count);
+        return std::make_pair(first, last);
+    };
+    auto [x0, x1] = cellRange(x, w, m_columns);
+    auto [y0, y1] = cellRange(y, h, m_rows);
+
+    ++m_slide;
+    for (int row = y0; row < y1; ++row) {
+        std::fill_n(m_covered.begin() + size_t(row) * m_columns + x0, x1 - x0, m_slide);
+    }
+    buildSums();
+}
+
+void PlacementGrid::buildSums()
+{
+    size_t stride = size_t(m_columns) + 1;
+    m_sums.assign(stride * (m_rows + 1), 0);
+    for (int y = 0; y < m_rows; ++y) {
+        uint64_t rowSum = 0;
+        const uint32_t *covered = &m_covered[size_t(y) * m_columns];
+        const uint64_t *above = &m_sums[y * stride];
+        uint64_t *sums = &m_sums[(y + 1) * stride];
+        for (int x = 0; x < m_columns; ++x) {
+            rowSum += covered[x];
+            sums[x + 1] = above[x + 1] + rowSum;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Picks where the next image goes on screen so that the areas left uncovered the longest
+// get covered. The screen is split into square cells, each one remembering the slide
+// that covered it last; a summed-area table of those gives the staleness of any
+// rectangle of cells in O(1), so every cell position of the image is scored. The image
+// goes at random to one of the positions within kTolerance of the stalest one.
+// The same seed and sequence of image sizes always give the same positions.
+class PlacementGrid
+{
+public:
+    static constexpr double kTolerance = 0.1;
+
+    PlacementGrid(int width, int height, int cellSize, uint64_t seed);
+
+    // forgets what covered what
+    void resize(int width, int height);
+    // top-left corner of a w x h image, within the screen as far as it fits
+    std::pair<int, int> place(int w, int h);
+
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+private:
+    void cover(int x, int y, int w, int h);
+    void buildSums();
+    // sum of m_covered over columns [x0, x1) and rows [y0, y1)
+    uint64_t coveredSum(int x0, int y0, int x1, int y1) const
+    {
+        size_t stride = size_t(m_columns) + 1;
+        return m_sums[y1 * stride + x1] - m_sums[y0 * stride + x1] - m_sums[y1 * stride + x0] + m_sums[y0 * stride + x0];
+    }
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_cellSize;
+    int m_columns = 0;
+    int m_rows = 0;
+    uint32_t m_slide = 0;               // number of images placed
+    std::vector<uint32_t> m_covered;    // slide that last covered each cell, row by row, 0 for none
+    std::vector<uint64_t> m_sums;       // summed-area table of m_covered, (columns + 1) x (rows + 1)
+    std::mt19937_64 m_random;
+};
@@ -0,0 +1,60 @@
+#include "pngdecoder.h"
+#include <png.h>
+#include <cstring>
+
+namespace {
+
+// frees what libpng holds for the image, on every way out
+struct PngImage : png_image
+{
+    PngImage()
+    {
+        std::memset(static_cast<png_image*>(this), 0, sizeof(png_image));
+        version = PNG_IMAGE_VERSION;
+    }
+    ~PngImage() { png_image_free(this); }
+};
+
+}
+
+bool PngDecoder::canDecode(const QByteArray &magic) const
+{
+    return magic.startsWith("\x89PNG\r\n\x1A\n");
+}
+
+QSize PngDecoder::imageSize(const FileData &file) const
+{
+    PngImage image;
+    if (file.isNull() || !png_image_begin_read_from_memory(&image, file.data(), size_t(file.size()))) {
+        return QSize();
+    }
+    return QSize(int(image.width), int(image.height));
+}
+
+DecodedImage PngDecoder::decode(const FileData &file, const QSize &) const
+{
+    PngImage png;
+    if (file.isNull() || !png_image_begin_read_from_memory(&png, file.data(), size_t(file.size()))) {
+        return DecodedImage();
+    }
+
+    QImage::Format format;
+    if ((png.format & PNG_FORMAT_FLAG_COLOR) == 0 && (png.format & PNG_FORMAT_FLAG_ALPHA) == 0) {
+        png.format = PNG_FORMAT_GRAY;
+        format = QImage::Format_Grayscale8;
+    } else {
+        // libpng fills the alpha of opaque images in, keeping 4 bytes per pixel keeps rows whole components
+        format = (png.format & PNG_FORMAT_FLAG_ALPHA) != 0 ? QImage::Format_RGBA8888 : QImage::Format_RGBX8888;
+        png.format = PNG_FORMAT_RGBA;
+    }
+    QImage image(int(png.width), int(png.height), format);
+    if (image.isNull()) {
+        return DecodedImage();
+    }
+    // the row stride is counted in components, one byte each
+    png_int_32 rowStride = png_int_32(image.bytesPerLine());
+    if (!png_image_finish_read(&png, nullptr, image.bits(), rowStride, nullptr)) {
+        return DecodedImage();
+    }
+    return image;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "imagedecoder.h"
+
+// Decodes PNGs with libpng's simplified API straight from the mapped file, to RGBA8888,
+// RGBX8888 for opaque images or Grayscale8, all formats uploaded as they are. PNG has no
+// cheaper way to a smaller size, images always come back at full size.
+class PngDecoder : public ImageDecoder
+{
+public:
+    const char *name() const override { return "png"; }
+    bool canDecode(const QByteArray &magic) const override;
+    QSize imageSize(const FileData &file) const override;
+    DecodedImage decode(const FileData &file, const QSize &scaledSize) const override;
+};
@@ -0,0 +1,269 @@
+#include "previewcache.h"
+#include "trace.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+struct PreviewHeader {
+    char magic[4];
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 chromaSubsampling[2];   // of planar previews, then the Y plane is followed by Cb and Cr
+    quint32 chromaBytesPerLine;
+};
+static_assert(sizeof(PreviewHeader) == 32, "pixel data must stay aligned after the header");
+
+const char kPreviewMagic[4] = { 'S', 'S', 'P', '1' };
+// not a QImage::Format
+const quint32 kPlanarYCbCr = 0x10000;
+
+bool isSupportedFormat(quint32 format)
+{
+    switch (format) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+    case QImage::Format_RGB888:
+    case QImage::Format_RGBA8888:
+    case QImage::Format_Grayscale8:
+    case kPlanarYCbCr:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// keys are SHA-1 digests in hex, other names are not ours
+bool isPreviewKey(const QString &name)
+{
+    if (name.size() != 40) {
+        return false;
+    }
+    for (QChar c : name) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hasPreviewMagic(const QString &path)
+{
+    QFile file(path);
+    char magic[sizeof(kPreviewMagic)];
+    return file.open(QIODevice::ReadOnly) && file.read(magic, sizeof(magic)) == qint64(sizeof(magic)) &&
+           std::memcmp(magic, kPreviewMagic, sizeof(kPreviewMagic)) == 0;
+}
+
+// the file is shared by the images of its planes
+void releaseMappedFile(void *file)
+{
+    delete static_cast<std::shared_ptr<QFile>*>(file);
+}
+
+}
+
+PreviewCache::PreviewCache(const QString &directory, qint64 maxBytes)
+: m_directory(directory),
+  m_maxBytes(maxBytes)
+{
+    QDir().mkpath(m_directory);
+}
+
+QString PreviewCache::keyFor(const QString &filePath, const QSize &targetSize) const
+{
+    QFileInfo info(filePath);
+    if (!info.exists()) {
+        return QString();
+    }
+    qint64 values[] = { info.lastModified().toMSecsSinceEpoch(), info.size(), targetSize.width(), targetSize.height() };
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(filePath.toUtf8());
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(values), sizeof(values)));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+DecodedImage PreviewCache::load(const QString &filePath, const QSize &targetSize)
+{
+    TRACE_SCOPE("load cached preview");
+    QString key = keyFor(filePath, targetSize);
+    if (key.isEmpty()) {
+        return DecodedImage();
+    }
+
+    auto file = std::make_unique<QFile>(m_directory + '/' + key);
+    if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(PreviewHeader))) {
+        return DecodedImage();
+    }
+    qint64 fileSize = file->size();
+    uchar *data = file->map(0, fileSize);
+    if (data == nullptr) {
+        return DecodedImage();
+    }
+
+    PreviewHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kPreviewMagic, sizeof(kPreviewMagic)) != 0 || !isSupportedFormat(header.format) ||
+        header.width == 0 || header.height == 0) {
+        return DecodedImage();
+    }
+
+    // planes are laid out the way the decoder makes them, the luma one padded to whole chroma pixels
+    bool planar = header.format == kPlanarYCbCr;
+    QSize planeSizes[3] = { QSize(header.width, header.height) };
+    qint64 bytesPerLine[3] = { header.bytesPerLine };
+    int planeCount = 1;
+    if (planar) {
+        quint32 sx = header.chromaSubsampling[0];
+        quint32 sy = header.chromaSubsampling[1];
+        if (sx == 0 || sy == 0 || sx > 4 || sy > 4) {
+            return DecodedImage();
+        }
+        planeSizes[0] = QSize((header.width + sx - 1) / sx * sx, (header.height + sy - 1) / sy * sy);
+        planeSizes[1] = planeSizes[2] = QSize(planeSizes[0].width() / sx, planeSizes[0].height() / sy);
+        bytesPerLine[1] = bytesPerLine[2] = header.chromaBytesPerLine;
+        planeCount = 3;
+    }
+    qint64 offsets[3];
+    qint64 totalBytes = 0;
+    for (int i = 0; i < planeCount; ++i) {
+        offsets[i] = qint64(sizeof(header)) + totalBytes;
+        totalBytes += bytesPerLine[i] * planeSizes[i].height();
+    }
+    if (totalBytes > fileSize - qint64(sizeof(header))) {
+        return DecodedImage();
+    }
+
+    // keep the order of use across runs
+    file->setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    {
+        QMutexLocker locker(&m_mutex);
+        ensureScanned();
+        touch(key, fileSize);
+    }
+
+    // pixels are used straight from the mapping, it goes away with the last copy of the image
+    auto mappedFile = std::shared_ptr<QFile>(file.release());
+    auto mapped = [&](int i, QImage::Format format) {
+        return QImage(const_cast<const uchar*>(data + offsets[i]), planeSizes[i].width(), planeSizes[i].height(), bytesPerLine[i],
+                      format, &releaseMappedFile, new std::shared_ptr<QFile>(mappedFile));
+    };
+    if (!planar) {
+        return DecodedImage(mapped(0, QImage::Format(header.format)));
+    }
+    DecodedImage image;
+    for (int i = 0; i < planeCount; ++i) {
+        image.planes[i] = mapped(i, QImage::Format_Grayscale8);
+    }
+    image.size = QSize(header.width, header.height);
+    return image;
+}
+
+void PreviewCache::store(const QString &filePath, const QSize &targetSize, const DecodedImage &image)
+{
+    TRACE_SCOPE("store cached preview");
+    QString key = keyFor(filePath, targetSize);
+    if (key.isEmpty() || image.isNull()) {
+        return;
+    }
+
+    PreviewHeader header = {};
+    std::memcpy(header.magic, kPreviewMagic, sizeof(kPreviewMagic));
+    header.width = image.width();
+    header.height = image.height();
+
+    QImage pixels = image.pixels;
+    if (image.isPlanar()) {
+        header.bytesPerLine = image.planes[0].bytesPerLine();
+        header.format = kPlanarYCbCr;
+        header.chromaSubsampling[0] = image.chromaSubsampling().width();
+        header.chromaSubsampling[1] = image.chromaSubsampling().height();
+        header.chromaBytesPerLine = image.planes[1].bytesPerLine();
+    } else {
+        if (pixels.format() == QImage::Format_RGB32) {
+            // opaque previews are kept at 3 bytes per pixel, less to read and to upload
+            pixels = pixels.convertToFormat(QImage::Format_RGB888);
+        } else if (!isSupportedFormat(pixels.format())) {
+            pixels = pixels.convertToFormat(pixels.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB888);
+        }
+        header.bytesPerLine = pixels.bytesPerLine();
+        header.format = pixels.format();
+    }
+
+    // written aside and renamed so other decode threads never map a partial file
+    QSaveFile out(m_directory + '/' + key);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    qint64 bytes = sizeof(header);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (image.isPlanar()) {
+        for (const auto &plane : image.planes) {
+            out.write(reinterpret_cast<const char*>(plane.constBits()), plane.sizeInBytes());
+            bytes += plane.sizeInBytes();
+        }
+    } else {
+        out.write(reinterpret_cast<const char*>(pixels.constBits()), pixels.sizeInBytes());
+        bytes += pixels.sizeInBytes();
+    }
+    if (!out.commit()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    ensureScanned();
+    touch(key, bytes);
+    evict();
+}
+
+void PreviewCache::ensureScanned()
+{
+    if (m_scanned) {
+        return;
+    }
+    m_scanned = true;
+
+    // only previews count against the budget and are ever evicted, whatever else is in there
+    const auto files = QDir(m_directory).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    for (const auto &info : files) {
+        if (isPreviewKey(info.fileName()) && hasPreviewMagic(info.filePath())) {
+            touch(info.fileName(), info.size());
+        }
+    }
+}
+
+void PreviewCache::touch(const QString &key, qint64 bytes)
+{
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_lru.splice(m_lru.end(), m_lru, it->lruPos);
+        m_totalBytes += bytes - it->bytes;
+        it->bytes = bytes;
+    } else {
+        m_entries.insert(key, Entry{ m_lru.insert(m_lru.end(), key), bytes });
+        m_totalBytes += bytes;
+    }
+}
+
+void PreviewCache::evict()
+{
+    while (m_totalBytes > m_maxBytes && !m_lru.empty()) {
+        QString key = m_lru.front();
+        m_lru.pop_front();
+        m_totalBytes -= m_entries.take(key).bytes;
+        QString path = m_directory + '/' + key;
+        if (hasPreviewMagic(path)) {
+            QFile::remove(path);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QString>
+#include <QImage>
+#include <QSize>
+#include <QHash>
+#include <QMutex>
+#include <list>
+#include "decodedimage.h"
+
+// On-disk cache of images already scaled down to the size they are displayed at.
+// Previews are stored as raw pixels, or raw planes, behind a small header and memory-mapped on load,
+// entries are keyed on source path, mtime, file size and target size. Thread-safe.
+class PreviewCache
+{
+public:
+    PreviewCache(const QString &directory, qint64 maxBytes);
+
+    DecodedImage load(const QString &filePath, const QSize &targetSize);
+    void store(const QString &filePath, const QSize &targetSize, const DecodedImage &image);
+
+private:
+    QString keyFor(const QString &filePath, const QSize &targetSize) const;
+    void ensureScanned();
+    void touch(const QString &key, qint64 bytes);
+    void evict();
+
+    struct Entry {
+        std::list<QString>::iterator lruPos;
+        qint64 bytes;
+    };
+
+    QString m_directory;
+    qint64 m_maxBytes;
+    qint64 m_totalBytes = 0;
+    bool m_scanned = false;
+
+    QMutex m_mutex;
+    std::list<QString> m_lru;       // least recently used first
+    QHash<QString, Entry> m_entries;
+};
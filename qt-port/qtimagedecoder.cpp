@@ -0,0 +1,59 @@
+#include "qtimagedecoder.h"
+#include <QImageReader>
+#include <QBuffer>
+#include <QFileInfo>
+
+namespace {
+
+// a reader of the mapped file, the plugins read the mapping in place; the suffix is a hint
+// for formats without magic bytes of their own
+class MappedImageReader : public QImageReader
+{
+public:
+    explicit MappedImageReader(const FileData &file)
+    : m_bytes(QByteArray::fromRawData(reinterpret_cast<const char*>(file.data()), qsizetype(file.size()))),
+      m_buffer(&m_bytes)
+    {
+        m_buffer.open(QIODevice::ReadOnly);
+        setDevice(&m_buffer);
+        setFormat(QFileInfo(file.path()).suffix().toLower().toLatin1());
+    }
+
+private:
+    QByteArray m_bytes;
+    QBuffer m_buffer;
+};
+
+}
+
+bool QtImageDecoder::canDecode(const QByteArray &) const
+{
+    // the plugins do their own sniffing, and fall back on the extension
+    return true;
+}
+
+QSize QtImageDecoder::imageSize(const FileData &file) const
+{
+    if (file.isNull()) {
+        return QSize();
+    }
+    return MappedImageReader(file).size();
+}
+
+DecodedImage QtImageDecoder::decode(const FileData &file, const QSize &scaledSize) const
+{
+    if (file.isNull()) {
+        return DecodedImage();
+    }
+    MappedImageReader reader(file);
+    if (!scaledSize.isValid()) {
+        return reader.read();
+    }
+    // let the decoder do the downscaling (DCT scaling for JPEG) instead of decoding every pixel;
+    // plugins that can't scale would have QImageReader smooth-scale the result, the loader's
+    // resampler does it faster
+    if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(scaledSize);
+    }
+    return reader.read();
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "imagedecoder.h"
+
+// Decodes through QImageReader and whatever image format plugins Qt has, for every format
+// the native decoders don't read.
+class QtImageDecoder : public ImageDecoder
+{
+public:
+    const char *name() const override { return "qt"; }
+    bool canDecode(const QByteArray &magic) const override;
+    QSize imageSize(const FileData &file) const override;
+    DecodedImage decode(const FileData &file, const QSize &scaledSize) const override;
+};
@@ -0,0 +1,390 @@
+#include "readahead.h"
+#include "trace.h"
+#include <QFile>
+#include <algorithm>
+#include <vector>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// reads of large files are split, the length of an io_uring read is 32-bit
+static const qint64 kMaxReadBytes = 1 << 30;
+
+#ifdef HAVE_LIBURING
+struct ReadAhead::Ring {
+    io_uring ring;
+};
+
+static io_uring_cqe *waitCompletion(io_uring *ring)
+{
+    io_uring_cqe *cqe = nullptr;
+    int result;
+    while ((result = io_uring_wait_cqe(ring, &cqe)) == -EINTR) {
+    }
+    return result == 0 ? cqe : nullptr;
+}
+#else
+struct ReadAhead::Ring {};
+#endif
+
+ReadAhead::ReadAhead(int queueDepth, qint64 maxBytes)
+: m_queueDepth(std::max(1, queueDepth)),
+  m_maxBytes(std::max<qint64>(1, maxBytes))
+{
+#ifdef HAVE_LIBURING
+    // room for an open and a statx per file of a batch; kernels without io_uring, or
+    // with it disabled, get the thread pool
+    auto ring = std::make_unique<Ring>();
+    if (io_uring_queue_init(unsigned(2 * m_queueDepth), &ring->ring, 0) == 0) {
+        m_ring = std::move(ring);
+    }
+#endif
+    if (m_ring != nullptr) {
+        m_pool.setMaxThreadCount(1);
+        m_pool.start([this]() { runBatches(); });
+    } else {
+        m_pool.setMaxThreadCount(m_queueDepth);
+    }
+}
+
+ReadAhead::~ReadAhead()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_changed.notify_all();
+    m_pool.clear();
+    m_pool.waitForDone();
+#ifdef HAVE_LIBURING
+    if (m_ring != nullptr) {
+        io_uring_queue_exit(&m_ring->ring);
+    }
+#endif
+}
+
+void ReadAhead::request(const QString &filePath)
+{
+    auto entry = std::make_unique<Entry>();
+    entry->path = filePath;
+    Entry *requested = entry.get();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // in thread mode its read task holds it from now on, in batches once it is in one
+        requested->claimed = m_ring == nullptr;
+        m_entries.push_back(std::move(entry));
+        ++m_stats.requests;
+    }
+    if (m_ring != nullptr) {
+        m_changed.notify_all();
+    } else {
+        m_pool.start([this, requested]() { readFile(requested); });
+    }
+}
+
+QByteArray ReadAhead::take(const QString &filePath)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&filePath](const std::unique_ptr<Entry> &entry) {
+        return entry->path == filePath && !entry->cancelled;
+    });
+    if (it == m_entries.end()) {
+        ++m_stats.misses;
+        return QByteArray();
+    }
+
+    Entry *entry = it->get();
+    if (entry->state == Entry::Queued) {
+        // it may wait for budget that only decodes sharing this thread pool free
+        ++m_stats.notStarted;
+        if (entry->claimed) {
+            entry->cancelled = true;
+        } else {
+            m_entries.erase(it);
+        }
+        lock.unlock();
+        m_changed.notify_all();
+        return QByteArray();
+    }
+    if (entry->state == Entry::Done) {
+        ++m_stats.hits;
+    } else {
+        ++m_stats.waits;
+        m_changed.wait(lock, [this, entry]() { return m_stopping || entry->state == Entry::Done; });
+        if (entry->state != Entry::Done) {
+            return QByteArray();
+        }
+    }
+
+    QByteArray data = std::move(entry->data);
+    m_heldBytes -= entry->reserved;
+    // requests made while waiting may have moved it
+    m_entries.erase(std::find_if(m_entries.begin(), m_entries.end(), [entry](const std::unique_ptr<Entry> &e) { return e.get() == entry; }));
+    lock.unlock();
+    m_changed.notify_all();
+    return data;
+}
+
+void ReadAhead::drop(const QString &filePath)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find_if(m_entries.begin(), m_entries.end(), [&filePath](const std::unique_ptr<Entry> &entry) {
+            return entry->path == filePath && !entry->cancelled;
+        });
+        if (it == m_entries.end()) {
+            return;
+        }
+        ++m_stats.dropped;
+        Entry *entry = it->get();
+        if (entry->state == Entry::Done || !entry->claimed) {
+            m_heldBytes -= entry->reserved;
+            m_entries.erase(it);
+        } else {
+            // its reader drops it once done with it
+            entry->cancelled = true;
+        }
+    }
+    m_changed.notify_all();
+}
+
+ReadAhead::Stats ReadAhead::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+// with m_mutex held
+bool ReadAhead::fits(const Entry *entry, qint64 bytes) const
+{
+    // the oldest file is read whatever the others hold, they can't be taken before it
+    return m_heldBytes + bytes <= m_maxBytes || entry == m_entries.front().get();
+}
+
+// with m_mutex held
+void ReadAhead::reserve(Entry *entry, qint64 bytes)
+{
+    entry->state = Entry::Reading;
+    entry->reserved = bytes;
+    m_heldBytes += bytes;
+    ++m_filesInFlight;
+    m_stats.peakBytes = std::max(m_stats.peakBytes, m_heldBytes);
+    m_stats.peakFilesInFlight = std::max(m_stats.peakFilesInFlight, m_filesInFlight);
+}
+
+void ReadAhead::finish(Entry *entry, const QByteArray &data)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (entry->state == Entry::Reading) {
+            --m_filesInFlight;
+        }
+        if (entry->cancelled) {
+            // taken before its read started, nobody else will take it
+            m_heldBytes -= entry->reserved;
+            m_entries.erase(std::find_if(m_entries.begin(), m_entries.end(), [entry](const std::unique_ptr<Entry> &e) { return e.get() == entry; }));
+        } else if (data.isNull()) {
+            m_heldBytes -= entry->reserved;
+            entry->reserved = 0;
+            ++m_stats.skipped;
+        } else {
+            entry->data = data;
+            ++m_stats.filesRead;
+            m_stats.bytesRead += data.size();
+        }
+        entry->state = Entry::Done;
+    }
+    m_changed.notify_all();
+}
+
+void ReadAhead::readFile(Entry *entry)
+{
+    TRACE_SCOPE("read ahead file");
+    QFile file(entry->path);
+    qint64 size = file.open(QIODevice::ReadOnly | QIODevice::Unbuffered) ? file.size() : 0;
+    if (size <= 0 || size > m_maxBytes) {
+        finish(entry, QByteArray());
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this, entry, size]() { return m_stopping || entry->cancelled || fits(entry, size); });
+        if (!m_stopping && !entry->cancelled) {
+            reserve(entry, size);
+        }
+    }
+
+    QByteArray data;
+    if (entry->state == Entry::Reading) {
+        data = QByteArray(size, Qt::Uninitialized);
+        if (file.read(data.data(), size) != size) {
+            data = QByteArray();
+        }
+    }
+    finish(entry, data);
+}
+
+void ReadAhead::runBatches()
+{
+    for (;;) {
+        std::vector<Entry*> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto isQueued = [](const std::unique_ptr<Entry> &entry) { return entry->state == Entry::Queued && !entry->claimed; };
+            m_changed.wait(lock, [this, &isQueued]() {
+                return m_stopping || std::any_of(m_entries.begin(), m_entries.end(), isQueued);
+            });
+            if (m_stopping) {
+                return;
+            }
+            // whatever was requested while the previous batch was read goes together
+            for (const auto &entry : m_entries) {
+                if (isQueued(entry) && int(batch.size()) < m_queueDepth) {
+                    entry->claimed = true;
+                    batch.push_back(entry.get());
+                }
+            }
+            ++m_stats.batches;
+        }
+        readBatch(batch);
+    }
+}
+
+void ReadAhead::readBatch(const std::vector<Entry*> &batch)
+{
+    TRACE_SCOPE("read ahead batch");
+#ifdef HAVE_LIBURING
+    io_uring *ring = &m_ring->ring;
+    size_t count = batch.size();
+    std::vector<QByteArray> paths(count);
+    std::vector<struct statx> stats(count);
+    std::vector<int> fds(count, -1);
+    std::vector<qint64> sizes(count, 0);
+
+    // the opens and sizes of the whole batch in one submission
+    for (size_t i = 0; i < count; ++i) {
+        paths[i] = QFile::encodeName(batch[i]->path);
+        io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        io_uring_prep_openat(sqe, AT_FDCWD, paths[i].constData(), O_RDONLY | O_CLOEXEC, 0);
+        io_uring_sqe_set_data64(sqe, i * 2);
+        sqe = io_uring_get_sqe(ring);
+        io_uring_prep_statx(sqe, AT_FDCWD, paths[i].constData(), 0, STATX_SIZE, &stats[i]);
+        io_uring_sqe_set_data64(sqe, i * 2 + 1);
+    }
+    int submitted = io_uring_submit_and_wait(ring, unsigned(2 * count));
+    for (int done = 0; done < submitted; ++done) {
+        io_uring_cqe *cqe = waitCompletion(ring);
+        if (cqe == nullptr) {
+            break;
+        }
+        quint64 data = io_uring_cqe_get_data64(cqe);
+        size_t i = data / 2;
+        if (data % 2 == 0) {
+            fds[i] = cqe->res >= 0 ? cqe->res : -1;
+        } else if (cqe->res == 0) {
+            sizes[i] = qint64(stats[i].stx_size);
+        }
+        io_uring_cqe_seen(ring, cqe);
+    }
+
+    // then their reads, in request order as long as the budget allows, the reads that
+    // fit being submitted together
+    std::vector<QByteArray> buffers(count);
+    std::vector<qint64> offsets(count, 0);
+    size_t next = 0;
+    bool stopping = false;
+    while (next < count && !stopping) {
+        std::vector<size_t> reading;
+        std::vector<size_t> skipped;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (; next < count; ++next) {
+                Entry *entry = batch[next];
+                if (entry->cancelled || fds[next] < 0 || sizes[next] <= 0 || sizes[next] > m_maxBytes) {
+                    skipped.push_back(next);
+                    continue;
+                }
+                if (!fits(entry, sizes[next])) {
+                    if (!reading.empty()) {
+                        break;
+                    }
+                    // everything before it is read, its decodes free the budget
+                    m_changed.wait(lock, [this, entry, size = sizes[next]]() { return m_stopping || entry->cancelled || fits(entry, size); });
+                    if (m_stopping) {
+                        stopping = true;
+                        break;
+                    }
+                    if (entry->cancelled) {
+                        skipped.push_back(next);
+                        continue;
+                    }
+                }
+                reserve(entry, sizes[next]);
+                reading.push_back(next);
+            }
+        }
+        for (size_t i : skipped) {
+            finish(batch[i], QByteArray());
+        }
+
+        for (size_t i : reading) {
+            buffers[i] = QByteArray(sizes[i], Qt::Uninitialized);
+        }
+        // short reads go again for the rest of the file
+        while (!reading.empty()) {
+            for (size_t i : reading) {
+                io_uring_sqe *sqe = io_uring_get_sqe(ring);
+                unsigned length = unsigned(std::min(kMaxReadBytes, sizes[i] - offsets[i]));
+                io_uring_prep_read(sqe, fds[i], buffers[i].data() + offsets[i], length, quint64(offsets[i]));
+                io_uring_sqe_set_data64(sqe, i);
+            }
+            submitted = io_uring_submit_and_wait(ring, unsigned(reading.size()));
+            std::vector<size_t> unfinished;
+            std::vector<bool> completed(count, false);
+            for (int done = 0; done < submitted; ++done) {
+                io_uring_cqe *cqe = waitCompletion(ring);
+                if (cqe == nullptr) {
+                    break;
+                }
+                size_t i = size_t(io_uring_cqe_get_data64(cqe));
+                completed[i] = true;
+                if (cqe->res > 0) {
+                    offsets[i] += cqe->res;
+                    if (offsets[i] < sizes[i]) {
+                        unfinished.push_back(i);
+                    } else {
+                        finish(batch[i], buffers[i]);
+                    }
+                } else {
+                    // failed, or the file shrank since its statx
+                    finish(batch[i], QByteArray());
+                }
+                io_uring_cqe_seen(ring, cqe);
+            }
+            for (size_t i : reading) {
+                if (!completed[i]) {
+                    finish(batch[i], QByteArray());
+                }
+            }
+            reading = std::move(unfinished);
+        }
+    }
+
+    for (; next < count; ++next) {
+        finish(batch[next], QByteArray());
+    }
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+#else
+    for (Entry *entry : batch) {
+        readFile(entry);
+    }
+#endif
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QThreadPool>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Reads the compressed bytes of the files coming next in the show ahead of their decode,
+// so that the open and read latency of network shares and spinning disks is paid for
+// several files at once instead of by each decode in turn. With io_uring, the requests
+// waiting when a batch starts are opened, sized and read as one batch of submissions;
+// without it, each file is read on its own thread of a pool. Bytes read and not taken
+// yet, or being read, stay within a budget. Decoders only ever wait for reads in progress:
+// a file whose read didn't start yet is left to its decoder, so that decode threads shared
+// by several loaders never wait on each other's files. Thread-safe.
+class ReadAhead
+{
+public:
+    struct Stats {
+        quint64 requests = 0;
+        quint64 filesRead = 0;
+        quint64 bytesRead = 0;
+        quint64 skipped = 0;    // too large for the budget, or unreadable, left to the decoder
+        quint64 batches = 0;
+        quint64 hits = 0;       // read by the time the decoder took them
+        quint64 waits = 0;      // the decoder waited for the read to complete
+        quint64 notStarted = 0; // the read hadn't started, the decoder read the file itself
+        quint64 misses = 0;     // never requested
+        quint64 dropped = 0;    // not needed, the decoder had a cached preview
+        qint64 peakBytes = 0;   // held by reads in flight and bytes not taken yet
+        int peakFilesInFlight = 0;
+    };
+
+    // queueDepth files are read at a time, for at most maxBytes held
+    ReadAhead(int queueDepth, qint64 maxBytes);
+    ~ReadAhead();
+
+    bool usesIoUring() const { return m_ring != nullptr; }
+    int queueDepth() const { return m_queueDepth; }
+    qint64 maxBytes() const { return m_maxBytes; }
+
+    // files are read in the order they are requested, and expected to be taken in it
+    void request(const QString &filePath);
+    // the contents of a requested file, waiting for its read if it is in progress; null when
+    // the file wasn't requested, couldn't be read ahead or its read didn't start yet, so
+    // that the caller reads it itself
+    QByteArray take(const QString &filePath);
+    // a requested file that won't be taken, its read is dropped without waiting for it
+    void drop(const QString &filePath);
+    Stats stats() const;
+
+private:
+    struct Entry {
+        enum State { Queued, Reading, Done };
+
+        QString path;
+        State state = Queued;
+        bool claimed = false;   // a read task or a batch holds it
+        bool cancelled = false; // taken before its read started or dropped, gone once its reader is done with it
+        QByteArray data;
+        qint64 reserved = 0;    // bytes counted in m_heldBytes
+    };
+    struct Ring;
+
+    bool fits(const Entry *entry, qint64 bytes) const;
+    void reserve(Entry *entry, qint64 bytes);
+    void finish(Entry *entry, const QByteArray &data);
+    void readFile(Entry *entry);
+    void runBatches();
+    void readBatch(const std::vector<Entry*> &batch);
+
+    int m_queueDepth;
+    qint64 m_maxBytes;
+    std::unique_ptr<Ring> m_ring;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<std::unique_ptr<Entry>> m_entries;   // in request order, until taken
+    qint64 m_heldBytes = 0;
+    int m_filesInFlight = 0;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    QThreadPool m_pool;     // destroyed first, waits for the reads in progress
+};
@@ -0,0 +1,147 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include "resampler.h"
+#include "imageutil.h"
+#include "latencystats.h"
+#include <functional>
+#include <iostream>
+#include <iomanip>
+
+// Downscale throughput of the resampler's kernels against QImage::scaled with
+// Qt::SmoothTransformation, in megapixels of the source per second. Images are decoded
+// once up front, only the scaling is measured, to the size the show would scale them to.
+
+struct BenchResult {
+    LatencyStats scaleMs;
+    double sourceMegapixels = 0.0;
+    double totalMs = 0.0;
+};
+
+static QList<QImage> loadImages(const QStringList &paths)
+{
+    QList<QImage> images;
+    auto add = [&images](const QString &filePath) {
+        QImage image = QImageReader(filePath).read();
+        if (!image.isNull()) {
+            images.append(image);
+        }
+    };
+    for (const auto &path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                add(it.next());
+            }
+        } else {
+            add(path);
+        }
+    }
+    return images;
+}
+
+// noise: the scalers don't look at the pixels, only their format and count matter
+static QImage syntheticImage(const QSize &size, QImage::Format format)
+{
+    QImage image(size, format);
+    for (int y = 0; y < image.height(); ++y) {
+        QRandomGenerator::global()->fillRange(reinterpret_cast<quint32*>(image.scanLine(y)), image.bytesPerLine() / 4);
+    }
+    return image;
+}
+
+static BenchResult run(const std::function<QImage(const QImage&, const QSize&)> &scale, const QList<QImage> &images, const QSize &targetSize, int repeat)
+{
+    BenchResult result;
+    for (int pass = 0; pass < repeat; ++pass) {
+        for (const auto &image : images) {
+            int w, h;
+            std::tie(w, h) = scaleToFit(image.width(), image.height(), targetSize.width(), targetSize.height());
+            QSize scaledSize(std::max(1, w), std::max(1, h));
+            QElapsedTimer timer;
+            timer.start();
+            scale(image, scaledSize);
+            double ms = timer.nsecsElapsed() / 1e6;
+            result.scaleMs.add(ms);
+            result.totalMs += ms;
+            result.sourceMegapixels += image.width() * double(image.height()) / 1e6;
+        }
+    }
+    return result;
+}
+
+static void print(const char *name, const BenchResult &result)
+{
+    double seconds = result.totalMs / 1000.0;
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << result.scaleMs.count() << " scaled"
+              << std::setw(10) << (seconds > 0 ? result.sourceMegapixels / seconds : 0.0) << " MP/s"
+              << std::setw(9) << result.scaleMs.percentile(0.5) << " ms p50"
+              << std::setw(9) << result.scaleMs.percentile(0.99) << " ms p99" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // Qt's image plugins need an application instance to be found
+    QGuiApplication app(argc, argv);
+
+    QCommandLineOption size(QStringList() << "size", "Scale down to fit this size (default: 1920x1080).", "WxH", "1920x1080");
+    QCommandLineOption repeat(QStringList() << "repeat", "Number of passes over the images (default: 3).", "count", "3");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Resampler throughput against QImage::scaled");
+    parser.addHelpOption();
+    parser.addOption(size);
+    parser.addOption(repeat);
+    parser.addPositionalArgument("paths", "Image files or directories, scanned recursively (default: synthetic 12, 24 and 48 MP images).");
+    parser.process(app);
+
+    QSize targetSize(1920, 1080);
+    QStringList sizeParts = parser.value(size).split(QRegularExpression("[xX]"));
+    if (sizeParts.size() == 2) {
+        targetSize = QSize(sizeParts[0].toInt(), sizeParts[1].toInt());
+    }
+    if (targetSize.isEmpty()) {
+        std::cerr << "Invalid size" << std::endl;
+        return 1;
+    }
+    int repeatCount = std::max(1, parser.value(repeat).toInt());
+
+    QList<QImage> images = loadImages(parser.positionalArguments());
+    if (images.isEmpty()) {
+        if (!parser.positionalArguments().isEmpty()) {
+            std::cerr << "No images to scale" << std::endl;
+            return 1;
+        }
+        for (QSize source : { QSize(4000, 3000), QSize(6000, 4000), QSize(8000, 6000) }) {
+            images.append(syntheticImage(source, QImage::Format_RGB32));
+        }
+    }
+
+    // grouped by format, the kernels and Qt's scaler both have per-format paths
+    QMap<int, QList<QImage>> byFormat;
+    for (const auto &image : images) {
+        byFormat[image.format()].append(image);
+    }
+    for (auto it = byFormat.begin(); it != byFormat.end(); ++it) {
+        std::cout << it.value().size() << " images of format " << it.key() << std::endl;
+        print("qt-smooth", run([](const QImage &image, const QSize &scaledSize) {
+            return image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }, it.value(), targetSize, repeatCount));
+        for (ResampleKernel kernel : { ResampleKernel::Scalar, ResampleKernel::Sse2, ResampleKernel::Avx2, ResampleKernel::Neon }) {
+            if (!isResampleKernelSupported(kernel)) {
+                continue;
+            }
+            print(resampleKernelName(kernel), run([kernel](const QImage &image, const QSize &scaledSize) {
+                return downscaleImage(image, scaledSize, kernel);
+            }, it.value(), targetSize, repeatCount));
+        }
+    }
+    return 0;
+}
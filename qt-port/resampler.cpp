@@ -0,0 +1,401 @@
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RESAMPLER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RESAMPLER_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(RESAMPLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// weights of the source pixels of an output pixel sum to 1 << kWeightBits; rows are
+// averaged into 16-bit values kept with kWeightBits - kRowShift bits of fraction
+static const int kWeightBits = 14;
+static const int kRowShift = 8;
+static const int kColumnShift = 2 * kWeightBits - kRowShift;
+
+namespace {
+
+// the source pixels each output pixel covers along one axis: count per output, from its
+// start, padded with zero weights so that every window has the same size
+struct Taps {
+    int count;
+    std::vector<int> starts;
+    std::vector<qint16> weights;
+};
+
+// SIMD kernels take the taps of an output pixel by multiples of their alignment
+struct Kernels {
+    void (*averageRows)(const uchar *const *rows, const qint16 *weights, int taps, int bytes, quint16 *dst);
+    void (*averageColumns)(const quint16 *src, const Taps &columns, int width, uchar *dst);
+    int rowAlignment;
+    int columnAlignment;
+};
+
+Taps computeTaps(int srcLength, int dstLength, int alignment)
+{
+    double ratio = double(srcLength) / dstLength;
+    int maxTaps = int(std::ceil(ratio)) + 1;
+    Taps taps;
+    taps.count = std::min(srcLength, (maxTaps + alignment - 1) / alignment * alignment);
+    taps.starts.resize(dstLength);
+    taps.weights.assign(size_t(dstLength) * taps.count, 0);
+
+    for (int x = 0; x < dstLength; ++x) {
+        double begin = x * ratio;
+        double end = std::min<double>(srcLength, (x + 1) * ratio);
+        int first = std::min(srcLength - 1, int(begin));
+        int last = std::max(first + 1, std::min(srcLength, int(std::ceil(end))));
+        // windows near the end start earlier instead of reading past the source
+        int start = std::min(first, srcLength - taps.count);
+        taps.starts[x] = start;
+
+        qint16 *weights = &taps.weights[size_t(x) * taps.count];
+        int total = 0;
+        int largest = first;
+        for (int i = first; i < last; ++i) {
+            double coverage = std::min<double>(i + 1, end) - std::max<double>(i, begin);
+            int weight = std::max(0, int(coverage / (end - begin) * (1 << kWeightBits) + 0.5));
+            weights[i - start] = qint16(weight);
+            total += weight;
+            if (weight > weights[largest - start]) {
+                largest = i;
+            }
+        }
+        // rounding errors go to the largest weight, the sum stays exact
+        weights[largest - start] = qint16(weights[largest - start] + (1 << kWeightBits) - total);
+    }
+    return taps;
+}
+
+// the bytes from..bytes of the rows, the tails SIMD kernels leave
+void averageRowRange(const uchar *const *rows, const qint16 *weights, int taps, int from, int bytes, quint16 *dst)
+{
+    for (int i = from; i < bytes; ++i) {
+        int sum = 1 << (kRowShift - 1);
+        for (int k = 0; k < taps; ++k) {
+            sum += rows[k][i] * weights[k];
+        }
+        dst[i] = quint16(sum >> kRowShift);
+    }
+}
+
+void averageRowsScalar(const uchar *const *rows, const qint16 *weights, int taps, int bytes, quint16 *dst)
+{
+    averageRowRange(rows, weights, taps, 0, bytes, dst);
+}
+
+void averageColumnsScalar(const quint16 *src, const Taps &columns, int width, int channels, uchar *dst)
+{
+    for (int x = 0; x < width; ++x) {
+        const quint16 *pixels = src + size_t(columns.starts[x]) * channels;
+        const qint16 *weights = &columns.weights[size_t(x) * columns.count];
+        for (int c = 0; c < channels; ++c) {
+            int sum = 1 << (kColumnShift - 1);
+            for (int k = 0; k < columns.count; ++k) {
+                sum += pixels[k * channels + c] * weights[k];
+            }
+            dst[x * channels + c] = uchar(std::min(255, sum >> kColumnShift));
+        }
+    }
+}
+
+void averageColumnsScalar4(const quint16 *src, const Taps &columns, int width, uchar *dst)
+{
+    averageColumnsScalar(src, columns, width, 4, dst);
+}
+
+#ifdef RESAMPLER_X86
+
+// two 16-bit weights in a 32-bit lane, for _mm_madd_epi16
+inline int weightPair(const qint16 *weights)
+{
+    return int(quint32(quint16(weights[0])) | quint32(quint16(weights[1])) << 16);
+}
+
+void averageRowsSse2(const uchar *const *rows, const qint16 *weights, int taps, int bytes, quint16 *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(1 << (kRowShift - 1));
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i));
+            __m128i w = _mm_set1_epi32(weightPair(weights + k));
+            // bytes of both rows interleaved as 16-bit pairs, madd gives a * wa + b * wb
+            __m128i lo = _mm_unpacklo_epi8(a, b);
+            __m128i hi = _mm_unpackhi_epi8(a, b);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+        // at most 14 bits, the signed pack doesn't saturate
+        __m128i out0 = _mm_packs_epi32(_mm_srli_epi32(acc0, kRowShift), _mm_srli_epi32(acc1, kRowShift));
+        __m128i out1 = _mm_packs_epi32(_mm_srli_epi32(acc2, kRowShift), _mm_srli_epi32(acc3, kRowShift));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), out1);
+    }
+    averageRowRange(rows, weights, taps, i, bytes, dst);
+}
+
+inline void storePixel(__m128i sum, uchar *dst)
+{
+    __m128i channels = _mm_srai_epi32(sum, kColumnShift);
+    channels = _mm_packs_epi32(channels, channels);
+    channels = _mm_packus_epi16(channels, channels);
+    int pixel = _mm_cvtsi128_si32(channels);
+    std::memcpy(dst, &pixel, 4);
+}
+
+void averageColumnsSse2(const quint16 *src, const Taps &columns, int width, uchar *dst)
+{
+    const __m128i round = _mm_set1_epi32(1 << (kColumnShift - 1));
+    for (int x = 0; x < width; ++x) {
+        const quint16 *pixels = src + size_t(columns.starts[x]) * 4;
+        const qint16 *weights = &columns.weights[size_t(x) * columns.count];
+        __m128i acc = round;
+        for (int k = 0; k < columns.count; k += 2) {
+            // two neighbour pixels, their channels interleaved as pairs
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + k * 4));
+            __m128i pairs = _mm_unpacklo_epi16(v, _mm_unpackhi_epi64(v, v));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pairs, _mm_set1_epi32(weightPair(weights + k))));
+        }
+        storePixel(acc, dst + x * 4);
+    }
+}
+
+TARGET_AVX2 void averageRowsAvx2(const uchar *const *rows, const qint16 *weights, int taps, int bytes, quint16 *dst)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(1 << (kRowShift - 1));
+    int i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + i));
+            __m256i w = _mm256_set1_epi32(weightPair(weights + k));
+            __m256i lo = _mm256_unpacklo_epi8(a, b);
+            __m256i hi = _mm256_unpackhi_epi8(a, b);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+        }
+        // unpacks and packs work within 128-bit lanes: bytes 0-7 and 16-23, then 8-15 and 24-31
+        __m256i out01 = _mm256_packs_epi32(_mm256_srli_epi32(acc0, kRowShift), _mm256_srli_epi32(acc1, kRowShift));
+        __m256i out23 = _mm256_packs_epi32(_mm256_srli_epi32(acc2, kRowShift), _mm256_srli_epi32(acc3, kRowShift));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute2x128_si256(out01, out23, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), _mm256_permute2x128_si256(out01, out23, 0x31));
+    }
+    averageRowRange(rows, weights, taps, i, bytes, dst);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // the OS must save the ymm registers too
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+#ifdef RESAMPLER_NEON
+
+void averageRowsNeon(const uchar *const *rows, const qint16 *weights, int taps, int bytes, quint16 *dst)
+{
+    int i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint32x4_t lo = vdupq_n_u32(1 << (kRowShift - 1));
+        uint32x4_t hi = lo;
+        for (int k = 0; k < taps; ++k) {
+            uint16x8_t v = vmovl_u8(vld1_u8(rows[k] + i));
+            lo = vmlal_n_u16(lo, vget_low_u16(v), quint16(weights[k]));
+            hi = vmlal_n_u16(hi, vget_high_u16(v), quint16(weights[k]));
+        }
+        vst1q_u16(dst + i, vcombine_u16(vshrn_n_u32(lo, kRowShift), vshrn_n_u32(hi, kRowShift)));
+    }
+    averageRowRange(rows, weights, taps, i, bytes, dst);
+}
+
+void averageColumnsNeon(const quint16 *src, const Taps &columns, int width, uchar *dst)
+{
+    for (int x = 0; x < width; ++x) {
+        const quint16 *pixels = src + size_t(columns.starts[x]) * 4;
+        const qint16 *weights = &columns.weights[size_t(x) * columns.count];
+        uint32x4_t acc = vdupq_n_u32(1 << (kColumnShift - 1));
+        for (int k = 0; k < columns.count; ++k) {
+            acc = vmlal_n_u16(acc, vld1_u16(pixels + k * 4), quint16(weights[k]));
+        }
+        uint16x4_t channels = vmovn_u32(vshrq_n_u32(acc, kColumnShift));
+        uint8x8_t pixel = vqmovn_u16(vcombine_u16(channels, channels));
+        vst1_lane_u32(reinterpret_cast<uint32_t*>(dst + x * 4), vreinterpret_u32_u8(pixel), 0);
+    }
+}
+
+#endif
+
+Kernels kernelsFor(ResampleKernel kernel)
+{
+    if (kernel == ResampleKernel::Auto) {
+        for (ResampleKernel best : { ResampleKernel::Avx2, ResampleKernel::Neon, ResampleKernel::Sse2 }) {
+            if (isResampleKernelSupported(best)) {
+                kernel = best;
+                break;
+            }
+        }
+    }
+    if (isResampleKernelSupported(kernel)) {
+        switch (kernel) {
+#ifdef RESAMPLER_X86
+        case ResampleKernel::Sse2:
+            return { averageRowsSse2, averageColumnsSse2, 2, 2 };
+        case ResampleKernel::Avx2:
+            // windows of four pixels waste more on zero weights than the wider registers win
+            return { averageRowsAvx2, averageColumnsSse2, 2, 2 };
+#endif
+#ifdef RESAMPLER_NEON
+        case ResampleKernel::Neon:
+            return { averageRowsNeon, averageColumnsNeon, 1, 1 };
+#endif
+        default:
+            break;
+        }
+    }
+    return { averageRowsScalar, averageColumnsScalar4, 1, 1 };
+}
+
+}
+
+bool isResampleKernelSupported(ResampleKernel kernel)
+{
+    switch (kernel) {
+    case ResampleKernel::Auto:
+    case ResampleKernel::Scalar:
+        return true;
+#ifdef RESAMPLER_X86
+    case ResampleKernel::Sse2:
+        return true;
+    case ResampleKernel::Avx2: {
+        static const bool hasAvx2 = cpuHasAvx2();
+        return hasAvx2;
+    }
+#endif
+#ifdef RESAMPLER_NEON
+    case ResampleKernel::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *resampleKernelName(ResampleKernel kernel)
+{
+    switch (kernel) {
+    case ResampleKernel::Auto: return "auto";
+    case ResampleKernel::Scalar: return "scalar";
+    case ResampleKernel::Sse2: return "sse2";
+    case ResampleKernel::Avx2: return "avx2";
+    case ResampleKernel::Neon: return "neon";
+    }
+    return "";
+}
+
+QImage downscaleImage(const QImage &image, const QSize &size, ResampleKernel kernel)
+{
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+    if (size == image.size()) {
+        return image;
+    }
+
+    // averaging straight alpha would bleed the color of transparent pixels into their neighbours
+    QImage source = image;
+    QImage::Format restoreFormat = QImage::Format_Invalid;
+    switch (image.format()) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+    case QImage::Format_RGB888:
+    case QImage::Format_Grayscale8:
+        break;
+    case QImage::Format_ARGB32:
+        source = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        restoreFormat = image.format();
+        break;
+    case QImage::Format_RGBA8888:
+        source = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+        restoreFormat = image.format();
+        break;
+    default:
+        if (image.hasAlphaChannel()) {
+            source = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+            restoreFormat = QImage::Format_RGBA8888;
+        } else {
+            source = image.convertToFormat(QImage::Format_RGBX8888);
+        }
+        break;
+    }
+
+    int channels = source.depth() / 8;
+    Kernels kernels = kernelsFor(kernel);
+    Taps rows = computeTaps(source.height(), size.height(), kernels.rowAlignment);
+    Taps columns = computeTaps(source.width(), size.width(), channels == 4 ? kernels.columnAlignment : 1);
+    // sources too small to pad windows to the alignment of the kernels take the scalar ones
+    auto averageRows = rows.count % kernels.rowAlignment == 0 ? kernels.averageRows : averageRowsScalar;
+    bool simdColumns = channels == 4 && columns.count % kernels.columnAlignment == 0;
+
+    QImage scaled(size, source.format());
+    if (scaled.isNull()) {
+        return QImage();
+    }
+    // one row at a time, averaged from the source rows it covers, then across its columns
+    std::vector<quint16> row(size_t(source.width()) * channels);
+    std::vector<const uchar*> rowPointers(rows.count);
+    for (int y = 0; y < size.height(); ++y) {
+        for (int k = 0; k < rows.count; ++k) {
+            rowPointers[k] = source.constScanLine(rows.starts[y] + k);
+        }
+        averageRows(rowPointers.data(), &rows.weights[size_t(y) * rows.count], rows.count, source.width() * channels, row.data());
+        if (simdColumns) {
+            kernels.averageColumns(row.data(), columns, size.width(), scaled.scanLine(y));
+        } else {
+            averageColumnsScalar(row.data(), columns, size.width(), channels, scaled.scanLine(y));
+        }
+    }
+
+    if (restoreFormat != QImage::Format_Invalid) {
+        scaled.convertTo(restoreFormat);
+    }
+    return scaled;
+}
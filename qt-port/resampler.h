@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+
+// Instruction sets the resampler has kernels for, Auto picks the best one the CPU runs.
+enum class ResampleKernel { Auto, Scalar, Sse2, Avx2, Neon };
+
+bool isResampleKernelSupported(ResampleKernel kernel);
+const char *resampleKernelName(ResampleKernel kernel);
+
+// Shrinks the image to size by area averaging: each output pixel is the mean of the
+// source pixels it covers, weighted by how much of them it covers, so nothing aliases
+// whatever the ratio. Rows are averaged first, then columns, in 8-bit x 14-bit fixed
+// point. Straight alpha is premultiplied for the averaging and restored after it; the
+// format is otherwise kept. Meant for shrinking, enlarging only interpolates linearly.
+QImage downscaleImage(const QImage &image, const QSize &size, ResampleKernel kernel = ResampleKernel::Auto);
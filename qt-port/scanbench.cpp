@@ -0,0 +1,164 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include "directoryscanner.h"
+#include "fileindex.h"
+#include <iostream>
+#include <iomanip>
+#include <map>
+
+// Time DirectoryScanner takes over a synthetic tree, to the first image reported and to
+// the end of the scan, with different thread counts and then again with the index of the
+// previous run. The tree is made of empty files, a tenth of them not images, in
+// directories of a given size grouped a hundred per parent directory.
+
+static const int kDirectoriesPerParent = 100;
+
+struct ScanResult {
+    double firstImageMs = -1.0;
+    double totalMs = 0.0;
+    int directories = 0;
+    int unchanged = 0;
+    int files = 0;
+};
+
+static bool buildTree(const QString &root, int fileCount, int filesPerDirectory)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int directories = (fileCount + filesPerDirectory - 1) / filesPerDirectory;
+    int written = 0;
+    for (int dir = 0; dir < directories; ++dir) {
+        QString dirPath = QString("%1/%2/%3").arg(root).arg(dir / kDirectoriesPerParent, 4, 10, QChar('0')).arg(dir % kDirectoriesPerParent, 2, 10, QChar('0'));
+        if (!QDir().mkpath(dirPath)) {
+            std::cerr << "Could not create " << dirPath.toStdString() << std::endl;
+            return false;
+        }
+        for (int i = 0; i < filesPerDirectory && written < fileCount; ++i, ++written) {
+            QString name = i % 10 == 9 ? QString("notes_%1.txt").arg(i) : QString("IMG_%1.jpg").arg(i, 4, 10, QChar('0'));
+            QFile file(dirPath + '/' + name);
+            if (!file.open(QIODevice::WriteOnly)) {
+                std::cerr << "Could not create " << file.fileName().toStdString() << std::endl;
+                return false;
+            }
+        }
+    }
+    std::cout << "Created " << fileCount << " files in " << directories << " directories in "
+              << std::fixed << std::setprecision(1) << timer.nsecsElapsed() / 1e9 << " s" << std::endl;
+    return true;
+}
+
+// the directories listed go to writer when given, saved as the index of the next run
+static ScanResult scan(const QString &root, int threads, const FileIndex *index, FileIndexWriter *writer)
+{
+    ScanResult result;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    std::map<QString, QStringList> listed;
+    DirectoryScanner scanner(QStringList() << "*.jpg" << "*.jpeg" << "*.png" << "*.webp", true, threads, index);
+    auto foundImages = [&result, &timer]() {
+        if (result.firstImageMs < 0) {
+            result.firstImageMs = timer.nsecsElapsed() / 1e6;
+        }
+    };
+    QObject::connect(&scanner, &DirectoryScanner::directoryScanned, &loop, [&foundImages, &listed, writer](const QString &dirPath, qint64, const QStringList &fileNames) {
+        if (!fileNames.isEmpty()) {
+            foundImages();
+        }
+        if (writer != nullptr) {
+            listed[dirPath] = fileNames;
+        }
+    });
+    QObject::connect(&scanner, &DirectoryScanner::directoryUnchanged, &loop, [&foundImages, index](quint32 indexedDir) {
+        if (index->fileCount(indexedDir) != 0) {
+            foundImages();
+        }
+    });
+    QObject::connect(&scanner, &DirectoryScanner::finished, &loop, &QEventLoop::quit);
+    timer.start();
+    scanner.scan(QStringList() << root);
+    loop.exec();
+    result.totalMs = timer.nsecsElapsed() / 1e6;
+    result.directories = scanner.scannedDirectories();
+    result.unchanged = scanner.unchangedDirectories();
+    result.files = scanner.foundFiles();
+
+    if (writer != nullptr) {
+        for (const auto &[dirPath, fileNames] : listed) {
+            writer->addDirectory(dirPath.toUtf8(), QFileInfo(dirPath).lastModified().toMSecsSinceEpoch());
+            for (const auto &fileName : fileNames) {
+                writer->addFile(fileName.toUtf8());
+            }
+        }
+    }
+    return result;
+}
+
+static void print(const std::string &name, const ScanResult &result)
+{
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << result.firstImageMs << " ms to first image"
+              << std::setw(10) << result.totalMs << " ms total"
+              << std::setw(9) << result.directories << " listed"
+              << std::setw(9) << result.unchanged << " unchanged"
+              << std::setw(9) << result.files << " images"
+              << std::setw(12) << std::setprecision(0) << (result.totalMs > 0 ? result.files / (result.totalMs / 1000) : 0.0) << " images/s" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineOption files(QStringList() << "files", "Number of files in the synthetic tree (default: 1000000).", "count", "1000000");
+    QCommandLineOption perDirectory(QStringList() << "per-directory", "Files per directory (default: 100).", "count", "100");
+    QCommandLineOption threads(QStringList() << "threads", "Thread counts to scan with (default: 1,4,16).", "list", "1,4,16");
+    QCommandLineOption tree(QStringList() << "tree", "Directory to scan instead of a synthetic tree, kept as it is.", "path");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Directory scanner speed");
+    parser.addHelpOption();
+    parser.addOption(files);
+    parser.addOption(perDirectory);
+    parser.addOption(threads);
+    parser.addOption(tree);
+    parser.process(app);
+
+    QTemporaryDir tempDir;
+    QString root = parser.value(tree);
+    if (root.isEmpty()) {
+        if (!tempDir.isValid()) {
+            std::cerr << "Could not create a temporary directory" << std::endl;
+            return 1;
+        }
+        root = tempDir.path();
+        if (!buildTree(root, std::max(1, parser.value(files).toInt()), std::max(1, parser.value(perDirectory).toInt()))) {
+            return 1;
+        }
+    }
+
+    // the first scan warms the directory caches of the OS, the ones timed list them from memory
+    FileIndexWriter writer;
+    scan(root, 1, nullptr, &writer);
+    int mostThreads = 1;
+    for (const auto &count : parser.value(threads).split(',', Qt::SkipEmptyParts)) {
+        int threadCount = std::max(1, count.trimmed().toInt());
+        mostThreads = std::max(mostThreads, threadCount);
+        print(std::to_string(threadCount) + " threads", scan(root, threadCount, nullptr, nullptr));
+    }
+
+    QTemporaryDir indexDir;
+    QString indexPath = indexDir.path() + "/scan.idx";
+    FileIndex index;
+    if (!indexDir.isValid() || !writer.save(indexPath) || !index.open(indexPath)) {
+        std::cerr << "Could not save the index" << std::endl;
+        return 1;
+    }
+    print("indexed", scan(root, mostThreads, &index, nullptr));
+    return 0;
+}
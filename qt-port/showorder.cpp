@@ -0,0 +1,103 @@
+#include "showorder.h"
+#include "imagelibrary.h"
+#include <algorithm>
+
+ShowOrder::ShowOrder(const ImageLibrary *library, bool shuffle, quint64 seed)
+: m_library(library),
+  m_shuffle(shuffle),
+  m_seed(seed)
+{
+}
+
+void ShowOrder::imagesAdded()
+{
+    if (m_passes.empty()) {
+        return;
+    }
+    // ids only ever grow, older passes keep the ids they had, the newest one takes the new ones
+    quint64 passNumber = m_passes.rbegin()->first;
+    Pass &pass = m_passes.rbegin()->second;
+    quint32 end = pass.segments.empty() ? 0 : pass.segments.back().firstId + pass.segments.back().size;
+    if (m_library->count() <= end) {
+        return;
+    }
+    quint32 added = m_library->count() - end;
+
+    // nothing handed out from the last segment yet: it can take them in
+    if (!pass.segments.empty() && pass.reached <= pass.segments.back().begin) {
+        Segment &last = pass.segments.back();
+        last.size += added;
+        if (m_shuffle) {
+            last.permutation = RandomPermutation(last.size, m_seed + (passNumber << 32) + pass.segments.size() - 1);
+        } else {
+            sortByPath(last);
+        }
+        pass.size += added;
+        return;
+    }
+    addSegment(passNumber, pass, end, added);
+}
+
+void ShowOrder::enterPass(quint64 passNumber)
+{
+    auto it = m_passes.find(passNumber);
+    if (it == m_passes.end()) {
+        it = m_passes.emplace(passNumber, Pass()).first;
+        if (m_library->count() != 0) {
+            addSegment(passNumber, it->second, 0, m_library->count());
+        }
+    }
+    ++it->second.loaders;
+}
+
+void ShowOrder::leavePass(quint64 passNumber)
+{
+    auto it = m_passes.find(passNumber);
+    if (it == m_passes.end()) {
+        return;
+    }
+    --it->second.loaders;
+    // a loader behind the others may still come to the passes after the oldest one in use
+    while (m_passes.size() > 1 && m_passes.begin()->second.loaders == 0) {
+        m_passes.erase(m_passes.begin());
+    }
+}
+
+quint64 ShowOrder::passSize(quint64 passNumber) const
+{
+    auto it = m_passes.find(passNumber);
+    return it != m_passes.end() ? it->second.size : 0;
+}
+
+quint32 ShowOrder::id(quint64 passNumber, quint64 position)
+{
+    Pass &pass = m_passes.at(passNumber);
+    pass.reached = std::max(pass.reached, position + 1);
+    auto segment = std::upper_bound(pass.segments.begin(), pass.segments.end(), position, [](quint64 position, const Segment &segment) {
+        return position < segment.begin;
+    }) - 1;
+    quint64 offset = position - segment->begin;
+    return m_shuffle ? segment->firstId + quint32(segment->permutation(offset)) : segment->ids[offset];
+}
+
+void ShowOrder::addSegment(quint64 passNumber, Pass &pass, quint32 firstId, quint32 size)
+{
+    Segment segment{ pass.size, firstId, size, RandomPermutation(), {} };
+    if (m_shuffle) {
+        segment.permutation = RandomPermutation(size, m_seed + (passNumber << 32) + pass.segments.size());
+    } else {
+        sortByPath(segment);
+    }
+    pass.segments.push_back(std::move(segment));
+    pass.size += size;
+}
+
+void ShowOrder::sortByPath(Segment &segment) const
+{
+    segment.ids.resize(segment.size);
+    for (quint32 i = 0; i < segment.size; ++i) {
+        segment.ids[i] = segment.firstId + i;
+    }
+    // ids come in the order directories finished scanning
+    std::sort(segment.ids.begin(), segment.ids.end(), [this](quint32 a, quint32 b) { return m_library->pathLess(a, b); });
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QtGlobal>
+#include <map>
+#include <vector>
+#include "permutation.h"
+
+class ImageLibrary;
+
+// The order the ids of the library are shown in, shared by the loaders taking turns in it.
+// A pass goes once through the ids the library had when it started and the ones added while
+// it runs, so however the library grows none is skipped or repeated within a pass. A pass
+// is made of segments each ordered on its own, permuted when shuffled and sorted by path
+// otherwise: ids added while no loader got to the last segment yet are ordered along with
+// it, the others make a new segment at the end. Images found while the first pass already
+// runs thus come after it in their own order, from the next pass on all are sorted by path.
+class ShowOrder
+{
+public:
+    ShowOrder(const ImageLibrary *library, bool shuffle, quint64 seed);
+
+    // to be called once per change, before the loaders are told
+    void imagesAdded();
+
+    // loaders say which pass they are in, the passes before the oldest one in use are forgotten
+    void enterPass(quint64 pass);
+    void leavePass(quint64 pass);
+    // the newest pass grows along with the library
+    quint64 passSize(quint64 pass) const;
+    // position lower than passSize(pass)
+    quint32 id(quint64 pass, quint64 position);
+
+private:
+    struct Segment {
+        quint64 begin;      // first position in the pass
+        quint32 firstId;
+        quint32 size;
+        RandomPermutation permutation;
+        std::vector<quint32> ids;   // sorted by path, when not shuffled
+    };
+
+    struct Pass {
+        std::vector<Segment> segments;
+        quint64 size = 0;
+        quint64 reached = 0;    // positions below were handed out
+        int loaders = 0;
+    };
+
+    void addSegment(quint64 passNumber, Pass &pass, quint32 firstId, quint32 size);
+    void sortByPath(Segment &segment) const;
+
+    const ImageLibrary *m_library;
+    bool m_shuffle;
+    quint64 m_seed;
+    std::map<quint64, Pass> m_passes;
+};
@@ -0,0 +1,107 @@
+#include "texturepool.h"
+
+// buckets are at most 1/8 of the size apart
+static int bucketLength(int length)
+{
+    static const int kMinimumLength = 64;
+    if (length <= kMinimumLength) {
+        return kMinimumLength;
+    }
+    int step = 1;
+    while (step * 16 <= length) {
+        step *= 2;
+    }
+    return (length + step - 1) / step * step;
+}
+
+TexturePool::TexturePool(qint64 budgetBytes)
+: m_budgetBytes(budgetBytes)
+{
+}
+
+void TexturePool::setBudget(qint64 budgetBytes)
+{
+    m_budgetBytes = budgetBytes;
+    trim();
+}
+
+QSize TexturePool::bucketSize(const QSize &size)
+{
+    return QSize(bucketLength(size.width()), bucketLength(size.height()));
+}
+
+qint64 TexturePool::textureBytes(const QOpenGLTexture &texture)
+{
+    int bytesPerPixel = 4;
+    switch (texture.format()) {
+    case QOpenGLTexture::RGB8_UNorm:
+        bytesPerPixel = 3;
+        break;
+    case QOpenGLTexture::R8_UNorm:
+        bytesPerPixel = 1;
+        break;
+    default:
+        break;
+    }
+    // a third more for the mipmaps
+    return qint64(texture.width()) * texture.height() * bytesPerPixel * 4 / 3;
+}
+
+std::unique_ptr<QOpenGLTexture> TexturePool::acquire(const QSize &size, QOpenGLTexture::TextureFormat format, QOpenGLTexture::PixelFormat pixelFormat)
+{
+    QSize bucket = bucketSize(size);
+    m_stats.requests += 1;
+
+    for (auto it = m_idle.begin(); it != m_idle.end(); ++it) {
+        const auto &texture = **it;
+        if (texture.width() == bucket.width() && texture.height() == bucket.height() && texture.format() == format) {
+            std::unique_ptr<QOpenGLTexture> reused = std::move(*it);
+            m_idle.erase(it);
+            m_stats.hits += 1;
+            m_stats.idleBytes -= textureBytes(*reused);
+            return reused;
+        }
+    }
+
+    std::unique_ptr<QOpenGLTexture> texture(new QOpenGLTexture(QOpenGLTexture::Target2D));
+    texture->setSize(bucket.width(), bucket.height());
+    texture->setFormat(format);
+    texture->setMipLevels(texture->maximumMipLevels());
+    texture->allocateStorage(pixelFormat, QOpenGLTexture::UInt8);
+    texture->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    texture->setMagnificationFilter(QOpenGLTexture::Linear);
+    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_stats.residentBytes += textureBytes(*texture);
+    // the new one is in use, room is made among the idle ones
+    trim();
+    return texture;
+}
+
+void TexturePool::release(std::unique_ptr<QOpenGLTexture> texture)
+{
+    if (texture == nullptr) {
+        return;
+    }
+    m_stats.idleBytes += textureBytes(*texture);
+    m_idle.push_back(std::move(texture));
+    trim();
+}
+
+void TexturePool::clear()
+{
+    for (const auto &texture : m_idle) {
+        m_stats.residentBytes -= textureBytes(*texture);
+    }
+    m_idle.clear();
+    m_stats.idleBytes = 0;
+}
+
+void TexturePool::trim()
+{
+    while (m_stats.residentBytes > m_budgetBytes && !m_idle.empty()) {
+        qint64 bytes = textureBytes(*m_idle.front());
+        m_stats.residentBytes -= bytes;
+        m_stats.idleBytes -= bytes;
+        m_idle.pop_front();
+    }
+}
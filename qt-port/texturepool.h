@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QOpenGLTexture>
+#include <QSize>
+#include <deque>
+#include <memory>
+
+// Textures with their mipmaps kept for reuse instead of being freed and allocated again
+// for every slide. Sizes are rounded up to buckets so that images of close sizes share
+// textures; the image only fills the top-left part of it. Idle textures are freed,
+// oldest first, when everything held goes over the budget.
+// All calls need the GL context of the textures current.
+class TexturePool
+{
+public:
+    explicit TexturePool(qint64 budgetBytes = 256 * 1024 * 1024);
+
+    void setBudget(qint64 budgetBytes);
+
+    // a texture of at least size, reused when an idle one of its bucket and format is left
+    std::unique_ptr<QOpenGLTexture> acquire(const QSize &size, QOpenGLTexture::TextureFormat format, QOpenGLTexture::PixelFormat pixelFormat);
+    void release(std::unique_ptr<QOpenGLTexture> texture);
+    void clear();
+
+    static QSize bucketSize(const QSize &size);
+
+    struct Stats {
+        quint64 requests = 0;
+        quint64 hits = 0;
+        qint64 residentBytes = 0;   // textures in use and idle ones
+        qint64 idleBytes = 0;
+    };
+    const Stats &stats() const { return m_stats; }
+
+private:
+    static qint64 textureBytes(const QOpenGLTexture &texture);
+    void trim();
+
+    qint64 m_budgetBytes;
+    std::deque<std::unique_ptr<QOpenGLTexture>> m_idle;    // least recently released first
+    Stats m_stats;
+};
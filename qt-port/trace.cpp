@@ -0,0 +1,253 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Event {
+    std::atomic<const char*> name { nullptr };
+    std::atomic<int64_t> begin { 0 };
+    std::atomic<int64_t> end { 0 };
+};
+
+// written by its thread only, without locks; events are numbered from 0 and event n lives in
+// slot n % kTraceEventsPerThread. claimed is raised before a slot is written and written after,
+// a reader keeps what it copied only if no writer claimed those slots again meanwhile
+struct Ring {
+    Event events[kTraceEventsPerThread];
+    std::atomic<uint64_t> claimed { 0 };
+    std::atomic<uint64_t> written { 0 };
+    int track = 0;
+    QString threadName;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    // left by threads that ended, pool threads come and go and the rings stay as many as
+    // the threads alive at once; the next thread carries on in the same track
+    std::vector<Ring*> free;
+};
+
+// never destroyed, pool threads may still record while statics go away
+Registry &registry()
+{
+    static Registry *registry = new Registry;
+    return *registry;
+}
+
+std::atomic<int64_t> startTime { 0 };
+
+int64_t clockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+QString currentThreadName()
+{
+    if (QCoreApplication::instance() != nullptr && QThread::currentThread() == QCoreApplication::instance()->thread()) {
+        return QStringLiteral("main");
+    }
+    QString name = QThread::currentThread()->objectName();
+    return name.isEmpty() ? QStringLiteral("thread") : name;
+}
+
+struct RingLease {
+    ~RingLease()
+    {
+        if (ring != nullptr) {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().free.push_back(ring);
+        }
+    }
+
+    Ring *ring = nullptr;
+};
+
+thread_local RingLease threadRing;
+
+Ring *currentRing()
+{
+    if (threadRing.ring == nullptr) {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.free.empty()) {
+            threadRing.ring = r.free.back();
+            r.free.pop_back();
+        } else {
+            r.rings.push_back(std::make_unique<Ring>());
+            threadRing.ring = r.rings.back().get();
+            threadRing.ring->track = int(r.rings.size());
+            threadRing.ring->threadName = currentThreadName();
+        }
+    }
+    return threadRing.ring;
+}
+
+struct CopiedEvent {
+    const char *name;
+    int64_t begin;
+    int64_t end;
+};
+
+// the events of the ring that were complete and not overwritten while they were copied
+std::vector<CopiedEvent> copyEvents(const Ring &ring)
+{
+    uint64_t last = ring.written.load(std::memory_order_acquire);
+    uint64_t first = last > uint64_t(kTraceEventsPerThread) ? last - kTraceEventsPerThread : 0;
+    std::vector<CopiedEvent> events;
+    events.reserve(last - first);
+    for (uint64_t i = first; i < last; ++i) {
+        const Event &event = ring.events[i % kTraceEventsPerThread];
+        events.push_back({ event.name.load(std::memory_order_relaxed), event.begin.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed) });
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claimed = ring.claimed.load(std::memory_order_relaxed);
+    uint64_t torn = claimed > uint64_t(kTraceEventsPerThread) ? claimed - kTraceEventsPerThread : 0;
+    if (torn > first) {
+        events.erase(events.begin(), events.begin() + std::min<uint64_t>(torn - first, events.size()));
+    }
+    return events;
+}
+
+QByteArray microseconds(int64_t ns)
+{
+    return QByteArray::number(ns / 1e3, 'f', 3);
+}
+
+} // namespace
+
+int64_t TraceDetail::now()
+{
+    return clockNs() - startTime.load(std::memory_order_relaxed);
+}
+
+void TraceDetail::record(const char *name, int64_t begin, int64_t end)
+{
+    Ring *ring = currentRing();
+    uint64_t index = ring->written.load(std::memory_order_relaxed);
+    ring->claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Event &event = ring->events[index % kTraceEventsPerThread];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    ring->written.store(index + 1, std::memory_order_release);
+}
+
+void startTrace()
+{
+    startTime.store(clockNs(), std::memory_order_relaxed);
+    TraceDetail::enabled.store(true, std::memory_order_release);
+}
+
+bool writeTrace(const QString &filePath)
+{
+    // the rings are never freed, they can be read outside the lock
+    std::vector<Ring*> rings;
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto &ring : r.rings) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool firstEvent = true;
+    auto append = [&json, &firstEvent](const QByteArray &event) {
+        if (!firstEvent) {
+            json += ",\n";
+        }
+        json += event;
+        firstEvent = false;
+    };
+    for (const Ring *ring : rings) {
+        QByteArray track = QByteArray::number(ring->track);
+        append(QJsonDocument(QJsonObject {
+            { "name", "thread_name" },
+            { "ph", "M" },
+            { "pid", QCoreApplication::applicationPid() },
+            { "tid", ring->track },
+            { "args", QJsonObject { { "name", ring->threadName } } },
+        }).toJson(QJsonDocument::Compact));
+        // complete events, begin and duration in microseconds
+        for (const CopiedEvent &event : copyEvents(*ring)) {
+            append("{\"name\":\"" + QByteArray(event.name) + "\",\"cat\":\"sss\",\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + track
+                   + ",\"ts\":" + microseconds(event.begin) + ",\"dur\":" + microseconds(event.end - event.begin) + "}");
+        }
+    }
+    json += "\n]}\n";
+
+    QSaveFile out(filePath);
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Could not write trace to " << filePath.toStdString() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#ifdef Q_OS_UNIX
+
+// the handler only wakes up the event loop, the trace is written from there
+static int signalPipe[2] = { -1, -1 };
+
+static void onTraceSignal(int)
+{
+    char byte = 0;
+    ssize_t written = write(signalPipe[1], &byte, 1);
+    (void)written;
+}
+
+void writeTraceOnSignal(const QString &filePath, QObject *parent)
+{
+    if (signalPipe[0] < 0) {
+        if (pipe(signalPipe) != 0) {
+            std::cerr << "Could not create the trace signal pipe" << std::endl;
+            return;
+        }
+        for (int fd : signalPipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    auto notifier = new QSocketNotifier(signalPipe[0], QSocketNotifier::Read, parent);
+    QObject::connect(notifier, &QSocketNotifier::activated, notifier, [filePath]() {
+        char bytes[64];
+        while (read(signalPipe[0], bytes, sizeof(bytes)) > 0) {
+        }
+        if (writeTrace(filePath)) {
+            std::cout << "Trace written to " << filePath.toStdString() << std::endl;
+        }
+    });
+
+    struct sigaction action = {};
+    action.sa_handler = onTraceSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+#else
+
+void writeTraceOnSignal(const QString &, QObject *)
+{
+}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+// Timeline of the pipeline stages: a TRACE_SCOPE records when the enclosing block began
+// and how long it took, in a ring buffer of the calling thread, and writeTrace() puts the
+// rings of every thread in a Chrome trace event file for chrome://tracing or
+// ui.perfetto.dev. Only compiled in with ENABLE_TRACE, the scopes are empty statements
+// otherwise; compiled in, they record nothing until startTrace().
+
+#ifdef ENABLE_TRACE
+
+#include <QString>
+#include <atomic>
+#include <cstdint>
+
+class QObject;
+
+// only the latest events of each thread are kept, older ones are overwritten
+static const int kTraceEventsPerThread = 16384;
+
+// scopes record from now on
+void startTrace();
+// safe while other threads are recording
+bool writeTrace(const QString &filePath);
+// writes the trace each time the process gets SIGUSR1, from the thread of parent
+void writeTraceOnSignal(const QString &filePath, QObject *parent);
+
+namespace TraceDetail {
+    inline std::atomic<bool> enabled { false };
+    // nanoseconds since startTrace()
+    int64_t now();
+    void record(const char *name, int64_t begin, int64_t end);
+}
+
+// the name is kept as is and has to outlive the trace: string literals
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+    : m_name(TraceDetail::enabled.load(std::memory_order_relaxed) ? name : nullptr),
+      m_begin(m_name != nullptr ? TraceDetail::now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (m_name != nullptr) {
+            TraceDetail::record(m_name, m_begin, TraceDetail::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope &operator=(const TraceScope&) = delete;
+
+private:
+    const char *m_name;
+    int64_t m_begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (false)
+
+#endif
@@ -0,0 +1,93 @@
+#include "turbojpegdecoder.h"
+#include <turbojpeg.h>
+#include <memory>
+
+namespace {
+
+struct DecompressorDeleter {
+    void operator()(void *handle) const { tjDestroy(handle); }
+};
+
+// the smallest scaled size of the decoder still covering scaledSize, the full size without one
+QSize pickScaledSize(int width, int height, const QSize &scaledSize)
+{
+    QSize best(width, height);
+    if (!scaledSize.isValid()) {
+        return best;
+    }
+    int count = 0;
+    const tjscalingfactor *factors = tjGetScalingFactors(&count);
+    for (int i = 0; i < count; ++i) {
+        if (factors[i].num >= factors[i].denom) {
+            continue;
+        }
+        QSize scaled(TJSCALED(width, factors[i]), TJSCALED(height, factors[i]));
+        if (scaled.width() >= scaledSize.width() && scaled.height() >= scaledSize.height() &&
+            qint64(scaled.width()) * scaled.height() < qint64(best.width()) * best.height()) {
+            best = scaled;
+        }
+    }
+    return best;
+}
+
+}
+
+bool TurboJpegDecoder::canDecode(const QByteArray &magic) const
+{
+    return magic.startsWith("\xFF\xD8\xFF");
+}
+
+QSize TurboJpegDecoder::imageSize(const FileData &file) const
+{
+    std::unique_ptr<void, DecompressorDeleter> decompressor(tjInitDecompress());
+    if (file.isNull() || decompressor == nullptr) {
+        return QSize();
+    }
+    int width, height, subsampling, colorspace;
+    if (tjDecompressHeader3(decompressor.get(), file.data(), file.size(), &width, &height, &subsampling, &colorspace) != 0) {
+        return QSize();
+    }
+    return QSize(width, height);
+}
+
+DecodedImage TurboJpegDecoder::decode(const FileData &file, const QSize &scaledSize) const
+{
+    if (file.isNull()) {
+        return DecodedImage();
+    }
+
+    std::unique_ptr<void, DecompressorDeleter> decompressor(tjInitDecompress());
+    if (decompressor == nullptr) {
+        return DecodedImage();
+    }
+    int width, height, subsampling, colorspace;
+    if (tjDecompressHeader3(decompressor.get(), file.data(), file.size(), &width, &height, &subsampling, &colorspace) != 0 ||
+        subsampling < 0 || (colorspace != TJCS_YCbCr && colorspace != TJCS_GRAY)) {
+        return DecodedImage();
+    }
+
+    QSize size = pickScaledSize(width, height, scaledSize);
+    int planeCount = subsampling == TJSAMP_GRAY ? 1 : 3;
+    DecodedImage image;
+    unsigned char *planes[3] = {};
+    int strides[3] = {};
+    for (int i = 0; i < planeCount; ++i) {
+        int planeWidth = tjPlaneWidth(i, size.width(), subsampling);
+        int planeHeight = tjPlaneHeight(i, size.height(), subsampling);
+        image.planes[i] = QImage(planeWidth, planeHeight, QImage::Format_Grayscale8);
+        if (image.planes[i].isNull()) {
+            return DecodedImage();
+        }
+        planes[i] = image.planes[i].bits();
+        strides[i] = int(image.planes[i].bytesPerLine());
+    }
+    if (tjDecompressToYUVPlanes(decompressor.get(), file.data(), file.size(), planes, size.width(), strides, size.height(), 0) != 0) {
+        return DecodedImage();
+    }
+
+    if (planeCount == 1) {
+        return DecodedImage(image.planes[0]);
+    }
+    image.size = size;
+    return image;
+}
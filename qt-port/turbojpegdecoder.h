@@ -0,0 +1,16 @@
+#pragma once
+
+#include "imagedecoder.h"
+
+// Decodes JPEGs with libjpeg-turbo into their Y, Cb and Cr planes, leaving the color
+// conversion to the GPU. The decoder scales down by the smallest of its factors that
+// keeps the image at least scaledSize. Grayscale JPEGs come back as Grayscale8 pixels;
+// CMYK ones, which turbo can't decode to planes, as null so they go through Qt instead.
+class TurboJpegDecoder : public ImageDecoder
+{
+public:
+    const char *name() const override { return "turbojpeg"; }
+    bool canDecode(const QByteArray &magic) const override;
+    QSize imageSize(const FileData &file) const override;
+    DecodedImage decode(const FileData &file, const QSize &scaledSize) const override;
+};
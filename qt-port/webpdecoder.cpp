@@ -0,0 +1,51 @@
+#include "webpdecoder.h"
+#include <webp/decode.h>
+
+bool WebpDecoder::canDecode(const QByteArray &magic) const
+{
+    return magic.size() >= 12 && magic.startsWith("RIFF") && magic.mid(8, 4) == "WEBP";
+}
+
+QSize WebpDecoder::imageSize(const FileData &file) const
+{
+    int width, height;
+    if (file.isNull() || !WebPGetInfo(file.data(), size_t(file.size()), &width, &height)) {
+        return QSize();
+    }
+    return QSize(width, height);
+}
+
+DecodedImage WebpDecoder::decode(const FileData &file, const QSize &scaledSize) const
+{
+    WebPDecoderConfig config;
+    if (file.isNull() || !WebPInitDecoderConfig(&config) ||
+        WebPGetFeatures(file.data(), size_t(file.size()), &config.input) != VP8_STATUS_OK ||
+        config.input.has_animation) {
+        return DecodedImage();
+    }
+
+    QSize size(config.input.width, config.input.height);
+    if (scaledSize.isValid() && (scaledSize.width() < size.width() || scaledSize.height() < size.height())) {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = scaledSize.width();
+        config.options.scaled_height = scaledSize.height();
+        size = scaledSize;
+    }
+    QImage image(size, config.input.has_alpha ? QImage::Format_RGBA8888 : QImage::Format_RGBX8888);
+    if (image.isNull()) {
+        return DecodedImage();
+    }
+
+    // decoded right into the image, libwebp writes opaque alpha for images without one
+    config.output.colorspace = MODE_RGBA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = image.bits();
+    config.output.u.RGBA.stride = int(image.bytesPerLine());
+    config.output.u.RGBA.size = size_t(image.sizeInBytes());
+    VP8StatusCode status = WebPDecode(file.data(), size_t(file.size()), &config);
+    WebPFreeDecBuffer(&config.output);
+    if (status != VP8_STATUS_OK) {
+        return DecodedImage();
+    }
+    return image;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "imagedecoder.h"
+
+// Decodes still WebPs with libwebp straight from the mapped file, to RGBA8888 or RGBX8888
+// for opaque images. libwebp scales while decoding, to exactly scaledSize. Animated WebPs
+// come back null and go through Qt, which shows their first frame.
+class WebpDecoder : public ImageDecoder
+{
+public:
+    const char *name() const override { return "webp"; }
+    bool canDecode(const QByteArray &magic) const override;
+    QSize imageSize(const FileData &file) const override;
+    DecodedImage decode(const FileData &file, const QSize &scaledSize) const override;
+};